@@ -23,6 +23,7 @@
 #include <vector>
 #include <map>
 #include <cmath>
+#include <algorithm>
 #include "AccElements.hpp"
 
 
@@ -31,6 +32,105 @@ using namespace pal;
 // static member definition
 AccPair AccElement::zeroPair;
 AccTriple AccElement::zeroTriple;
+const size_t AccElementPool::headerSize = ((sizeof(BlockHeader)-1)/alignof(std::max_align_t)+1) * alignof(std::max_align_t);
+
+
+
+// ---------- AccElementPool ----------
+
+AccElementPool::~AccElementPool()
+{
+  for (auto &c : chunks) {
+    for (size_t offset=0; offset<c.used; ) {
+      BlockHeader* h = reinterpret_cast<BlockHeader*>(c.data+offset);
+      if (h->alive)
+	reinterpret_cast<AccElement*>(c.data+offset+headerSize)->~AccElement();
+      offset += headerSize + h->size;
+    }
+    delete[] c.data;
+  }
+}
+
+// memory for an element of given size. reuses memory of destroyed elements if possible.
+void* AccElementPool::allocate(size_t size)
+{
+  size = ((size-1)/alignof(std::max_align_t)+1) * alignof(std::max_align_t);
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto f = freeBlocks.find(size);
+  if (f != freeBlocks.end() && !f->second.empty()) {
+    BlockHeader* h = f->second.back();
+    f->second.pop_back();
+    return reinterpret_cast<char*>(h) + headerSize;
+  }
+
+  if (chunks.empty() || chunks.back().size - chunks.back().used < headerSize+size) {
+    Chunk c;
+    c.size = std::max(chunkSize, headerSize+size);
+    c.data = new char[c.size];
+    c.used = 0;
+    chunks.push_back(c);
+  }
+  Chunk &c = chunks.back();
+  BlockHeader* h = new(c.data+c.used) BlockHeader;
+  h->size = size;
+  h->alive = false;
+  h->owner = this;
+  h->refs.store(0, std::memory_order_relaxed);
+  c.used += headerSize + size;
+  return reinterpret_cast<char*>(h) + headerSize;
+}
+
+// element constructed at p: 1 reference (creator)
+void AccElementPool::setAlive(void* p)
+{
+  BlockHeader* h = reinterpret_cast<BlockHeader*>(static_cast<char*>(p)-headerSize);
+  h->refs.store(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(mutex);
+  h->alive = true;
+  n++;
+}
+
+void AccElementPool::deallocate(void* p)
+{
+  BlockHeader* h = reinterpret_cast<BlockHeader*>(static_cast<char*>(p)-headerSize);
+  std::lock_guard<std::mutex> lock(mutex);
+  freeBlocks[h->size].push_back(h);
+}
+
+void AccElementPool::destroy(AccElement* e)
+{
+  BlockHeader* h = header(e);
+  e->~AccElement();
+  bool last;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    h->alive = false;
+    n--;
+    freeBlocks[h->size].push_back(h);
+    last = (disowned && n == 0);
+  }
+  if (last)
+    delete this;
+}
+
+void AccElementPool::disown()
+{
+  bool empty;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    disowned = true;
+    empty = (n == 0);
+  }
+  if (empty)
+    delete this;
+}
+
+void AccElementPool::release(const AccElement* e)
+{
+  if (header(e)->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    poolOf(e)->destroy(const_cast<AccElement*>(e));
+}
 
 
 string pal::filterCharactersForLaTeX(string in)
@@ -121,6 +221,7 @@ AccElement::AccElement(element_type _type, string _name, double _length)
   }
   else if (length > 0.)
     this->checkPhysLength();
+  updateEdge();
 }
 
 
@@ -222,6 +323,11 @@ AccElement& AccElement::operator=(const AccElement* other)
 // B_rf(orbit,turn) = B(orbit) * rfFactor(turn)
 // ! fixed starting phase
 double AccElement::rfFactor(unsigned int turn) const
+{
+  return rfFactor(turn, Qrf1, dQrf, rfPeriod);
+}
+
+double AccElement::rfFactor(unsigned int turn, double Qrf1, double dQrf, unsigned int rfPeriod)
 {
   if(Qrf1==0. && dQrf==0.)
     return 1.;
@@ -234,6 +340,72 @@ double AccElement::rfFactor(unsigned int turn) const
 
 
 
+void RfFactorTable::add(const AccElement *e)
+{
+  if (!e->isRF() || last < first)
+    return;
+  std::vector<double> &f = factor[e];
+  f.resize(last-first+1);
+  for (unsigned int t=first; t<=last; t++)
+    f[t-first] = e->rfFactor(t);
+}
+
+double RfFactorTable::operator()(const AccElement *e, unsigned int turn) const
+{
+  if (turn >= first && turn <= last) {
+    auto it = factor.find(e);
+    if (it != factor.end())
+      return it->second[turn-first];
+  }
+  return e->rfFactor(turn);
+}
+
+
+
+// magnetic field types. All magnets use Magnet::B(orbit), all others have no field.
+bool AccElement::hasField() const
+{
+  switch(type) {
+  case dipole:
+  case quadrupole:
+  case corrector:
+  case sextupole:
+  case multipole:
+  case solenoid:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// parameters of Magnet::B(orbit). sin/cos are only calculated for tilt!=0
+ElementField::ElementField(const AccElement &e)
+  : zero(!e.hasField())
+{
+  if (zero)
+    return;
+  k0x = e.k0.x;
+  k0z = e.k0.z;
+  k0s = e.k0.s;
+  k1 = e.k1;
+  k2 = e.k2;
+  sign = (e.family==D) ? -1. : 1.;
+  dx = e.displacement.x;
+  dz = e.displacement.z;
+  if (e.tilt == 0.) { // sin(+-0) = +-0
+    cosM = cosP = 1.;
+    sinM = - e.tilt;
+    sinP = e.tilt;
+  }
+  else {
+    cosM = cos(- e.tilt);
+    sinM = sin(- e.tilt);
+    cosP = cos(e.tilt);
+    sinP = sin(e.tilt);
+  }
+}
+
+
 // true if element name matches entry in List (can include 1 wildcard *)
 bool AccElement::nameMatch(const vector<string> &nameList) const
 {
@@ -246,34 +418,21 @@ bool AccElement::nameMatch(const vector<string> &nameList) const
 
 
 // true if element name matches pattern (can include 1 wildcard *)
+// "before*after" matches names beginning with "before" and ending with "after" (see also NameMatcher)
 bool AccElement::nameMatch(const string &pattern) const
 {
-
-  if (this->name.size() < pattern.size()-1)
-    return false;
-
   size_t wildcardPos = pattern.find("*");
 
-  if (wildcardPos != string::npos) { // if wildcard * occurs in pattern
-    if (this->name.substr(0,wildcardPos) != pattern.substr(0,wildcardPos)) {//match before wildcard
-      return false;
-    }
-    string afterString = pattern.substr(wildcardPos+1);
-    if (afterString.size() == 0) {
-      return true;
-    }
-    size_t afterPos = this->name.find( afterString ); //first pos after wildcard in name
-    if (afterPos == string::npos) { //afterString not found in name
-      return false;
-    }
-    else if (afterString.size() < this->name.substr(afterPos).size()) {
-      return false;
-    }
-  }
-  else {
-    if (this->name != pattern)       // if no wildcard occurs
-      return false;
-  }
+  if (wildcardPos == string::npos) // if no wildcard occurs
+    return (this->name == pattern);
+
+  size_t afterSize = pattern.size() - wildcardPos - 1;
+  if (this->name.size() < wildcardPos + afterSize)
+    return false;
+  if (this->name.compare(0, wildcardPos, pattern, 0, wildcardPos) != 0) //match before wildcard
+    return false;
+  if (this->name.compare(this->name.size()-afterSize, afterSize, pattern, wildcardPos+1, afterSize) != 0) //match after wildcard
+    return false;
 
   return true; 
 }
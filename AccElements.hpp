@@ -26,6 +26,13 @@
 #include <cmath>
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <atomic>
+#include <mutex>
 #include "SimTools.hpp"
 #include "types.hpp"
 #include "config.hpp"
@@ -47,6 +54,114 @@ namespace pal
   string type_string(element_type t, SimTool tool);
 
 
+
+  class AccElement;
+
+  // compact field parameters of an element (created by AccElement::field()).
+  // non-virtual, inlinable field calculation for hot loops with the same results as AccElement::B(orbit).
+  class ElementField {
+  public:
+    bool zero;                       // element has no magnetic field (no magnet), all other members are undefined
+    double k0x, k0z, k0s, k1, k2;
+    double sign;                     // sign of k1,k2: -1 for family D
+    double dx, dz;                   // displacement / m
+    double cosM, sinM;               // cos/sin(-tilt): orbit to system of magnet
+    double cosP, sinP;               // cos/sin(+tilt): field back to lab frame
+
+    ElementField() : zero(true) {}
+    explicit ElementField(const AccElement &e);
+
+    // same calculation as Magnet::B(orbit)
+    void B(double x, double z, AccTriple &out) const {
+      double ox = x - dx;
+      double oz = z - dz;
+      double ptx = ox*cosM + oz*sinM;
+      double ptz = - ox*sinM + oz*cosM;
+      double bx = (k1*ptz + k2*ptx*ptz) * sign + k0x;
+      double bz = (k1*ptx + 0.5*k2*(ptx*ptx-ptz*ptz)) * sign + k0z;
+      out.x = bx*cosP + bz*sinP;
+      out.z = - bx*sinP + bz*cosP;
+      out.s = 0. * sign + k0s;
+    }
+    AccTriple B(const AccPair &orbit) const {
+      AccTriple tmp;
+      if (!zero)
+	B(orbit.x, orbit.z, tmp);
+      return tmp;
+    }
+    // n orbit points (x[i],z[i]). loop without calls, vectorizable
+    void B(const double *x, const double *z, unsigned int n, AccTriple *out) const {
+      if (zero) {
+	std::fill(out, out+n, AccTriple());
+	return;
+      }
+      for (unsigned int i=0; i<n; i++)
+	B(x[i], z[i], out[i]);
+    }
+  };
+
+  // memory pool for elements (used by AccLattice)
+  // elements are created one after another in large memory chunks (few allocations, order of creation is kept).
+  // destroy() calls the destructor and keeps the memory for new elements of the same size.
+  // remaining elements are destroyed together with the pool.
+  // elements are reference counted, so they can be shared by several lattices (copy-on-write):
+  // create() sets 1 reference, release() destroys the element after the last one (thread-safe).
+  // A pool created with new can be disown()ed by its owner. Then it is deleted after its last element.
+  class AccElementPool {
+  private:
+    struct Chunk {char* data; size_t size; size_t used;};
+    struct BlockHeader {size_t size; bool alive; AccElementPool* owner; std::atomic<unsigned int> refs;}; // in front of each element
+    static const size_t headerSize;
+    std::vector<Chunk> chunks;
+    std::unordered_map<size_t, std::vector<BlockHeader*>> freeBlocks; // destroyed elements by size
+    size_t chunkSize;
+    unsigned int n;
+    bool disowned;
+    mutable std::mutex mutex;  // elements can be released from other threads
+
+    void* allocate(size_t size);
+    void setAlive(void* p);
+    void deallocate(void* p);  // memory from allocate() without element (constructor failed)
+    static BlockHeader* header(const AccElement* e) {return reinterpret_cast<BlockHeader*>(const_cast<char*>(reinterpret_cast<const char*>(e))-headerSize);}
+
+  public:
+    explicit AccElementPool(size_t _chunkSize=ELEMENTPOOL_CHUNK_SIZE) : chunkSize(_chunkSize), n(0), disowned(false) {}
+    ~AccElementPool();
+    AccElementPool(const AccElementPool&) = delete;
+    AccElementPool& operator=(const AccElementPool&) = delete;
+
+    template <class T, class... Args> T* make(Args&&... args);  // new element T(args...)
+    template <class T> T* create(const T& other) {return make<T>(other);}
+    void destroy(AccElement* e);  // e must be created by this pool. destroyed independent of references
+    unsigned int size() const {std::lock_guard<std::mutex> lock(mutex); return n;}  // number of elements
+    void disown();                // owner does not use the pool anymore (pool created with new)
+    struct Disown {void operator()(AccElementPool* p) const {p->disown();}}; // deleter for std::unique_ptr
+    struct Release {void operator()(const AccElement* e) const {release(e);}}; // deleter for std::unique_ptr of elements created by a pool
+
+    // e must be created by a pool:
+    static AccElementPool* poolOf(const AccElement* e) {return header(e)->owner;} // pool that created e
+    static void retain(const AccElement* e) {header(e)->refs.fetch_add(1, std::memory_order_relaxed);}
+    static void release(const AccElement* e);                                      // destroy e after last reference
+    static unsigned int useCount(const AccElement* e) {return header(e)->refs.load(std::memory_order_acquire);}
+  };
+
+  template <class T, class... Args>
+  T* AccElementPool::make(Args&&... args)
+  {
+    void* p = allocate(sizeof(T));
+    T* e;
+    try {
+      e = new(p) T(std::forward<Args>(args)...);
+    }
+    catch (...) {
+      deallocate(p);
+      throw;
+    }
+    setAlive(p);
+    return e;
+  }
+
+
   
 // abstract base class
 class AccElement {
@@ -54,6 +169,8 @@ protected:
   static AccPair zeroPair;
   static AccTriple zeroTriple;
   double physLength;      // physical length (used for edge field calculation (pal::AccLattice::B()) / m
+  double halfDl, sigma;   // cached dl()/2 and Gaussian sigma of edge field (see AccLattice::slope()) / m
+  void updateEdge() {halfDl = dl()/2; sigma = halfDl * sqrt(2./M_PI);}
 
   // following data can be accessed and modified. Only type and length of an element must not be changed.
 public:
@@ -92,22 +209,30 @@ public:
   virtual bool operator==(const AccElement &other) const;
   virtual bool operator!=(const AccElement &other) const;
   virtual AccElement* clone() const =0;
+  virtual AccElement* clone(AccElementPool &pool) const =0;  // copy created in pool
 
   // physical length (used for edge field calculation (pal::AccLattice::B()) / m
-  void setPhysLength(double pl) {physLength = pl; this->checkPhysLength();}
-  void setPhysLength() {physLength = 0.; this->checkPhysLength();}
+  void setPhysLength(double pl) {physLength = pl; this->checkPhysLength(); updateEdge();}
+  void setPhysLength() {physLength = 0.; this->checkPhysLength(); updateEdge();}
   double getPhysLength() const {return physLength;}
   double dl() const {return fabs(length - getPhysLength());}  // difference of (effective) length and physical length / m
+  double edgeHalfDl() const {return halfDl;}                   // dl()/2: length of edge field at each magnet end / m
+  double edgeSigma() const {return sigma;}                     // sigma of Gaussian edge field slope / m
 
   // magnetic field
   virtual AccTriple B() const =0;
   virtual AccTriple B(const AccPair &orbit) const =0;
+  void B(const double *x, const double *z, unsigned int n, AccTriple *out) const {field().B(x,z,n,out);} // out[i] = B(orbit (x[i],z[i])) for n orbit points
+  ElementField field() const {return ElementField(*this);}  // field parameters for non-virtual B(orbit) (dispatch by element type)
+  bool hasField() const;                                     // element type is a magnet (B(orbit) can be !=0)
 
   // integral magnetic field
   virtual AccTriple B_int() const {return B() * length;}
   virtual AccTriple B_int(const AccPair &orbit) const {return B(orbit) * length;}
   //RF magnets (oscillating fields)
-  double rfFactor(unsigned int turn) const; // Magnetic field amplitude factor for oscillating fields
+  double rfFactor(unsigned int turn) const; // Magnetic field amplitude factor for oscillating fields (see RfFactorTable)
+  static double rfFactor(unsigned int turn, double Qrf1, double dQrf, unsigned int rfPeriod); // same for given RF parameters
+  bool isRF() const {return (Qrf1!=0. || dQrf!=0.);} // oscillating field (rfFactor() != 1)
   AccTriple B_rf(unsigned int turn) const {return B() * rfFactor(turn);}
   AccTriple B_rf(unsigned int turn, const AccPair &orbit) const {return B(orbit) * rfFactor(turn);}
 
@@ -156,6 +281,23 @@ protected:
 };
 
 
+// rfFactor(turn) of RF elements for turns [firstTurn,lastTurn], calculated once
+// (e.g. for field calculation of many samples and turns, see AccLattice::rfFactorTable()).
+// the table is owned by the caller, elements are not modified. After a change of Qrf1, dQrf or rfPeriod
+// of an element, the table must be built again.
+class RfFactorTable {
+protected:
+  unsigned int first, last;
+  std::unordered_map<const AccElement*, std::vector<double>> factor;
+
+public:
+  RfFactorTable(unsigned int firstTurn=1, unsigned int lastTurn=0) : first(firstTurn), last(lastTurn) {}
+  void add(const AccElement *e);                                // tabulate rfFactor() of e (RF elements only)
+  double operator()(const AccElement *e, unsigned int turn) const; // from table, if available, else e->rfFactor(turn)
+  unsigned int size() const {return factor.size();}            // number of tabulated elements
+};
+
+
   // no magnet, B-Field=0 (abstract)
   class NoMagnet : public AccElement {
   public:
@@ -163,6 +305,7 @@ protected:
       : AccElement(_type,_name,_length) {}
     
     virtual NoMagnet* clone() const =0;
+    virtual NoMagnet* clone(AccElementPool &pool) const =0;
     
     virtual AccTriple B() const {return zeroTriple;}
     virtual AccTriple B(const AccPair&) const {return B();}
@@ -179,6 +322,7 @@ public:
   ~Drift() {}
   
   virtual Drift* clone() const {return new Drift(*this);}
+  virtual Drift* clone(AccElementPool &pool) const {return pool.create(*this);}
 
   virtual string printLaTeX() const;
 };
@@ -191,6 +335,7 @@ public:
     ~Marker() {}
     
     virtual Marker* clone() const {return new Marker(*this);}
+    virtual Marker* clone(AccElementPool &pool) const {return pool.create(*this);}
 
     virtual string printSimTool(SimTool t) const;
     virtual string printLaTeX() const;
@@ -204,6 +349,7 @@ public:
     ~Monitor() {}
     
     virtual Monitor* clone() const {return new Monitor(*this);}
+    virtual Monitor* clone(AccElementPool &pool) const {return pool.create(*this);}
 
     virtual string printSimTool(SimTool t) const;
     virtual string printLaTeX() const;
@@ -218,6 +364,7 @@ public:
   ~Cavity() {}
 
   virtual Cavity* clone() const {return new Cavity(*this);}
+  virtual Cavity* clone(AccElementPool &pool) const {return pool.create(*this);}
   
   virtual string printSimTool(SimTool t) const;
   virtual string printLaTeX() const;
@@ -232,6 +379,7 @@ public:
     ~Rcollimator() {}
 
     virtual Rcollimator* clone() const {return new Rcollimator(*this);}
+    virtual Rcollimator* clone(AccElementPool &pool) const {return pool.create(*this);}
   
     virtual string printSimTool(SimTool t) const;
     virtual string printLaTeX() const;
@@ -247,6 +395,7 @@ public:
       : AccElement(_type,_name,_length), rf(_rf) {}
 
     virtual Magnet* clone() const =0;
+    virtual Magnet* clone(AccElementPool &pool) const =0;
 
     virtual AccTriple B() const;
     virtual AccTriple B(const AccPair &orbit) const;
@@ -270,6 +419,7 @@ public:
       : Magnet(multipole,_name,_length) {family=_family;}
 
     virtual Multipole* clone() const {return new Multipole(*this);}
+    virtual Multipole* clone(AccElementPool &pool) const {return pool.create(*this);}
 
     virtual AccTriple B() const;
     virtual string printSimTool(SimTool t) const;
@@ -288,6 +438,7 @@ public:
   ~Dipole() {}
 
   virtual Dipole* clone() const {return new Dipole(*this);}
+  virtual Dipole* clone(AccElementPool &pool) const {return pool.create(*this);}
 
   double R() const {return 1/k0.z;}
   void setR(double R) {k0=AccTriple(); k0.z=1/R;}
@@ -303,6 +454,7 @@ public:
   ~Corrector() {}
 
   virtual Corrector* clone() const {return new Corrector(*this);}
+  virtual Corrector* clone(AccElementPool &pool) const {return pool.create(*this);}
 
   string printSimTool(SimTool t) const;
   string printLaTeX() const;
@@ -315,6 +467,7 @@ public:
   ~Solenoid() {}
 
   virtual Solenoid* clone() const {return new Solenoid(*this);}
+  virtual Solenoid* clone(AccElementPool &pool) const {return pool.create(*this);}
 
   string printSimTool(SimTool t) const;
   string printLaTeX() const;
@@ -334,6 +487,7 @@ public:
   ~Quadrupole() {}
 
   virtual Quadrupole* clone() const {return new Quadrupole(*this);}
+  virtual Quadrupole* clone(AccElementPool &pool) const {return pool.create(*this);}
 
   string printSimTool(SimTool t) const;
   string printLaTeX() const;
@@ -346,6 +500,7 @@ public:
   ~Sextupole() {}
 
   virtual Sextupole* clone() const {return new Sextupole(*this);}
+  virtual Sextupole* clone(AccElementPool &pool) const {return pool.create(*this);}
 
   string printSimTool(SimTool t) const;
   string printLaTeX() const;
@@ -27,6 +27,10 @@
  * -> iterate over all elements in lattice
  * AccLattice::type_iterator & AccLattice::const_type_iterator
  * -> iterate over all elements of one type in lattice
+ *
+ * *it and it.element() are read only pointers to the element (const AccElement*) for all iterators.
+ * it.modify() of non-const iterators gives write access (the element is copied, if it is shared with a copy of the lattice).
+ * Only modify() invalidates element data of the lattice (e.g. theta(), name index), so use element() to read.
  */
 
 
@@ -46,26 +50,31 @@ class AccTypeIterator;
 
   // abstract base class:
   template <bool IS_CONST>
-  class AccIterator_Base : public std::iterator<std::input_iterator_tag, std::conditional<IS_CONST, const AccElement*, AccElement*>>{
+  class AccIterator_Base : public std::iterator<std::input_iterator_tag, const AccElement*>{
     friend class AccLattice;
     typedef typename std::conditional<IS_CONST, const AccElement*, AccElement*>::type ValueType;
     typedef typename std::conditional<IS_CONST, const AccMap, AccMap>::type MapType;
     typedef typename std::conditional<IS_CONST, AccMap::const_iterator, AccMap::iterator>::type IteratorType;
+    typedef typename std::conditional<IS_CONST, const AccLattice, AccLattice>::type LatticeType;
     
   protected:
-    IteratorType it;
+    IteratorType it;                // moved to own map of the lattice on write access (copy-on-write)
     MapType* latticeElements;
     const Anchor* latticeRefPos;
     const double* latticeCircumference;
-    AccIterator_Base(IteratorType in, MapType* e, const Anchor* rP, const double* circ) : it(in), latticeElements(e), latticeRefPos(rP), latticeCircumference(circ) {}
+    LatticeType* lattice;           // used for type index (iteration over one element type) and copy-on-write of elements
+    unsigned int typeIndexHint;     // probable index of it in type index of lattice (checked before use)
+    AccIterator_Base(IteratorType in, MapType* e, const Anchor* rP, const double* circ, LatticeType* l)
+      : it(in), latticeElements(e), latticeRefPos(rP), latticeCircumference(circ), lattice(l), typeIndexHint(0) {}
     void checkForEnd() const;
 
   public:
-    AccIterator_Base(const AccIterator_Base<false>& o) : it(o.it), latticeElements(o.latticeElements), latticeRefPos(o.latticeRefPos), latticeCircumference(o.latticeCircumference) {}
+    AccIterator_Base(const AccIterator_Base<false>& o) : it(o.it), latticeElements(o.latticeElements), latticeRefPos(o.latticeRefPos), latticeCircumference(o.latticeCircumference), lattice(o.lattice), typeIndexHint(o.typeIndexHint) {}
     // accessors
     double pos() const {checkForEnd(); return it->first;}         // position in Lattice in meter
-    ValueType element() const {checkForEnd(); return it->second;}  // pointer to Element
-    ValueType operator*() {return element();}
+    const AccElement* element() const {checkForEnd(); return it->second;}        // pointer to Element, read only
+    const AccElement* operator*() const {checkForEnd(); return it->second;}       // pointer to Element, read only
+    AccElement* modify();                                                         // pointer to Element with write access (non-const iterators only, see AccLattice)
     
     // iteration
     bool isEnd() const {return (it==latticeElements->end());}
@@ -88,6 +97,9 @@ class AccTypeIterator;
     void next_helper(element_type t, element_plane p, element_family f);
     void prev_helper(element_type t, element_plane p, element_family f);
     void revolve_helper();
+    static bool match(const AccElement* e, element_type t, element_plane p, element_family f) {return e->type==t && (p==noplane || e->plane==p) && (f==nofamily || e->family==f);}
+  private:
+    unsigned int typeIndexPos(const std::vector<AccMap::iterator>& list) const; // index of first entry in type index list with position >= this position
   };
 
 
@@ -101,9 +113,10 @@ class AccTypeIterator;
     typedef typename std::conditional<IS_CONST, const AccElement*, AccElement*>::type ValueType;
     typedef typename std::conditional<IS_CONST, const AccMap, AccMap>::type MapType;
     typedef typename std::conditional<IS_CONST, AccMap::const_iterator, AccMap::iterator>::type IteratorType;
+    typedef typename std::conditional<IS_CONST, const AccLattice, AccLattice>::type LatticeType;
     
   protected:
-    AccIterator(IteratorType in, MapType* e, const Anchor* rP, const double* circ) : AccIterator_Base<IS_CONST>(in,e,rP,circ) {}
+    AccIterator(IteratorType in, MapType* e, const Anchor* rP, const double* circ, LatticeType* l) : AccIterator_Base<IS_CONST>(in,e,rP,circ,l) {}
     void setBegin() override {this->it = this->latticeElements->begin();}
     
   public:
@@ -149,9 +162,10 @@ class AccTypeIterator;
     typedef typename std::conditional<IS_CONST, const AccElement*, AccElement*>::type ValueType;
     typedef typename std::conditional<IS_CONST, const AccMap, AccMap>::type MapType;
     typedef typename std::conditional<IS_CONST, AccMap::const_iterator, AccMap::iterator>::type IteratorType;
+    typedef typename std::conditional<IS_CONST, const AccLattice, AccLattice>::type LatticeType;
 
   protected:
-    AccTypeIterator(IteratorType in, MapType* e, const Anchor* rP, const double* circ) : AccIterator_Base<IS_CONST>(in,e,rP,circ) {}
+    AccTypeIterator(IteratorType in, MapType* e, const Anchor* rP, const double* circ, LatticeType* l) : AccIterator_Base<IS_CONST>(in,e,rP,circ,l) {}
     void setBegin() override {this->it=this->latticeElements->begin(); if(this->it->second->type!=TYPE) next();}
 
   public:
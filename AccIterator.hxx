@@ -48,25 +48,54 @@ void AccLattice::AccIterator_Base<IS_CONST>::checkForEnd() const
 
 
 // iteration helper functions
+// use type index of lattice: only elements of type t are checked
+
+// index of first entry in type index list with position >= this position
+template<bool IS_CONST>
+unsigned int AccLattice::AccIterator_Base<IS_CONST>::typeIndexPos(const std::vector<AccMap::iterator>& list) const
+{
+  if (it == latticeElements->end())
+    return list.size();
+  if (typeIndexHint < list.size() && list[typeIndexHint] == it)
+    return typeIndexHint;
+  double here = it->first;
+  auto entry = std::lower_bound(list.begin(), list.end(), here, [](const AccMap::iterator& e, double pos) {return e->first < pos;});
+  return entry - list.begin();
+}
+
 template<bool IS_CONST>
 void AccLattice::AccIterator_Base<IS_CONST>::next_helper(element_type t, element_plane p, element_family f)
 {
-  ++it;
-  for (; it!=latticeElements->end(); ++it) {
-    if ( it->second->type==t && (p==noplane || it->second->plane==p) && (f==nofamily || it->second->family==f) )
-      break;
+  const std::vector<AccMap::iterator>& list = lattice->typeIndex(t);
+  unsigned int i = typeIndexPos(list);
+  if (i < list.size() && list[i]->first == it->first)
+    i++;
+  for (; i<list.size(); i++) {
+    if (match(list[i]->second,t,p,f)) {
+      it = list[i];
+      typeIndexHint = i;
+      return;
+    }
   }
+  it = latticeElements->end();
   //throw noMatchingElement("type, plane, family");
 }
 
+// no previous match: lattice.begin()
 template<bool IS_CONST>
 void AccLattice::AccIterator_Base<IS_CONST>::prev_helper(element_type t, element_plane p, element_family f)
 {
-  --it;
-  for (; it!=latticeElements->begin(); --it) {
-    if ( it->second->type==t && (p==noplane || it->second->plane==p) && (f==nofamily || it->second->family==f) )
-      break;
+  const std::vector<AccMap::iterator>& list = lattice->typeIndex(t);
+  unsigned int i = typeIndexPos(list);
+  while (i > 0) {
+    i--;
+    if (match(list[i]->second,t,p,f)) {
+      it = list[i];
+      typeIndexHint = i;
+      return;
+    }
   }
+  it = latticeElements->begin();
   //throw noMatchingElement("type, plane, family");
 }
 
@@ -123,19 +152,20 @@ double AccLattice::AccIterator_Base<IS_CONST>::distance(Anchor anchor, double po
   return pos - this->pos(anchor);
 }
 
+// write access: element is copied, if it is shared with another lattice (copy-on-write)
+template<bool IS_CONST>
+AccElement* AccLattice::AccIterator_Base<IS_CONST>::modify()
+{
+  static_assert(!IS_CONST, "AccLattice: no write access to elements by const_iterator");
+  checkForEnd();
+  return lattice->writeAccess(it,latticeElements);
+}
+
 // both directions are checked, shorter distance is returned.
 template<bool IS_CONST>
 double AccLattice::AccIterator_Base<IS_CONST>::distanceRing(Anchor anchor, double pos) const
 {
-  double d_normal = distance(anchor,pos);
-  double d_other = *latticeCircumference - abs(d_normal);
-  if ( d_other >= 0.5 * *latticeCircumference ) // regular direction shorter
-    return d_normal;
-  else {
-    if (d_normal>0)
-      d_other *= -1;
-    return d_other;
-  }
+  return ringDistance(distance(anchor,pos), *latticeCircumference);
 }
 
 
@@ -25,7 +25,10 @@
 #include <iomanip>
 #include <stdexcept>
 #include <limits>
+#include <complex>
+#include <gsl/gsl_sf_dawson.h>
 #include "AccLattice.hpp"
+#include "FunctionOfPos.hpp"
 
 using namespace pal;
 
@@ -41,7 +44,7 @@ string pal::removeQuote(string s)
 
 //constructor
 AccLattice::AccLattice(double _circumference, Anchor _refPos)
-  : circ(0.), ignoreCounter(0), refPos(_refPos)
+  : circ(0.), elements(newMap()), pool(new AccElementPool), ignoreCounter(0), posIndexOn(true), posIndexValid(false), posIndexWidth(0.), typeIndexValid(false), thetaIndexValid(false), nameIndexValid(false), nameIndexDirty(false), refPos(_refPos)
 {
   empty_space = new Drift;
 
@@ -51,7 +54,7 @@ AccLattice::AccLattice(double _circumference, Anchor _refPos)
 }
 
 AccLattice::AccLattice(SimToolInstance &sim, Anchor _refPos, string ignoreFile)
-  : circ(0.), ignoreCounter(0), refPos(_refPos)
+  : circ(0.), elements(newMap()), pool(new AccElementPool), ignoreCounter(0), posIndexOn(true), posIndexValid(false), posIndexWidth(0.), typeIndexValid(false), thetaIndexValid(false), nameIndexValid(false), nameIndexDirty(false), refPos(_refPos)
 {
   empty_space = new Drift;
 
@@ -62,22 +65,38 @@ AccLattice::AccLattice(SimToolInstance &sim, Anchor _refPos, string ignoreFile)
 }
 
 //copy constructor
+// elements are shared with other (copy-on-write): constant time, no element is copied here
 AccLattice::AccLattice(const AccLattice &other)
-  : circ(other.circumference()), ignoreList(other.ignoreList), refPos(other.refPos), info(other.info)
+  : circ(other.circumference()), elements(other.elements), pool(new AccElementPool), ignoreList(other.ignoreList), ignoreMatcher(other.ignoreMatcher), ignoreCounter(other.ignoreCounter), posIndexOn(other.posIndexOn), posIndexValid(false), posIndexWidth(0.), typeIndexValid(false), thetaIndexValid(false), nameIndexValid(false), nameIndexDirty(false), refPos(other.refPos), info(other.info)
 {
   empty_space = new Drift;
+}
 
-  for (auto it=other.begin(); it!=other.end(); ++it) {
-    this->mount(it.pos(), *(it.element()));
-  }
+// move constructor
+// elements and indices are taken from other, other is left empty
+// (position index is rebuilt, because it can contain other.elements.end())
+AccLattice::AccLattice(AccLattice &&other)
+  : circ(other.circ), elements(std::move(other.elements)), pool(std::move(other.pool)), ignoreList(std::move(other.ignoreList)), ignoreMatcher(std::move(other.ignoreMatcher)), ignoreCounter(other.ignoreCounter), comment(std::move(other.comment)), posIndexOn(other.posIndexOn), posIndexValid(false), posIndexWidth(0.), typeIndexValid(other.typeIndexValid.load()), typeIndexLists(std::move(other.typeIndexLists)), thetaIndexValid(other.thetaIndexValid.load()), thetaBegin(std::move(other.thetaBegin)), thetaEnd(std::move(other.thetaEnd)), thetaK0z(std::move(other.thetaK0z)), thetaSum(std::move(other.thetaSum)), nameIndexValid(other.nameIndexValid.load()), nameIndexDirty(other.nameIndexDirty.load()), nameIndex(std::move(other.nameIndex)), nameIndexPending(std::move(other.nameIndexPending)), refPos(other.refPos), info(std::move(other.info))
+{
+  empty_space = new Drift;
+  other.clearMovedFrom();
 }
 
+// leave a valid, empty lattice after move
+void AccLattice::clearMovedFrom()
+{
+  elements = newMap();
+  pool.reset(new AccElementPool);
+  nameIndex.clear();
+  nameIndexPending.clear();
+  invalidateIndices();
+  nameIndexValid = false;
+}
 
+
+// elements are released with the map, pool is deleted after its last element
 AccLattice::~AccLattice()
 {
-  for (auto it=begin(); it!=end(); ++it) {
-    delete it.element();
-  }
   delete empty_space;
 }
 
@@ -96,14 +115,59 @@ AccLattice& AccLattice::operator= (const AccLattice &other)
   // 	<< circumference() <<"/"<< other.circumference() <<")";
   //   throw palatticeError(msg.str());
   // }
+  if (this == &other)
+    return *this;
+
   circ = other.circ;
   ignoreList = other.ignoreList;
+  ignoreMatcher = other.ignoreMatcher;
+  ignoreCounter = other.ignoreCounter;
   info = other.info;
-  
-  for (auto it=other.begin(); it!=other.end(); ++it) {
-    this->mount(it.pos(), *(it.element()));
+
+  // replace all elements. elements are shared with other (copy-on-write)
+  elements = other.elements;
+  invalidateIndices();
+  nameIndexValid = false;
+
+  return *this;
+}
+
+// move assignment: replaces all elements by the ones of other, other is left empty
+AccLattice& AccLattice::operator= (AccLattice &&other)
+{
+  stringstream msg;
+
+  if (refPos != other.refPos) {
+    msg << "ERROR: AccLattice::operator=(): Cannot assign Lattice - different refPos ("
+  	<< refPos_string() <<"/"<< other.refPos_string() <<")";
+    throw palatticeError(msg.str());
   }
+  if (this == &other)
+    return *this;
 
+  circ = other.circ;
+  ignoreList = std::move(other.ignoreList);
+  ignoreMatcher = std::move(other.ignoreMatcher);
+  ignoreCounter = other.ignoreCounter;
+  info = std::move(other.info);
+
+  // own elements are released with the replaced map
+  elements = std::move(other.elements);
+  pool = std::move(other.pool);
+  typeIndexValid = other.typeIndexValid.load();
+  typeIndexLists = std::move(other.typeIndexLists);
+  thetaIndexValid = other.thetaIndexValid.load();
+  thetaBegin = std::move(other.thetaBegin);
+  thetaEnd = std::move(other.thetaEnd);
+  thetaK0z = std::move(other.thetaK0z);
+  thetaSum = std::move(other.thetaSum);
+  nameIndexValid = other.nameIndexValid.load();
+  nameIndexDirty = other.nameIndexDirty.load();
+  nameIndex = std::move(other.nameIndex);
+  nameIndexPending = std::move(other.nameIndexPending);
+  posIndexValid = false;
+
+  other.clearMovedFrom();
   return *this;
 }
 
@@ -126,6 +190,7 @@ void AccLattice::setCircumference(double c)
 
   circ = c;
   info.add("AccLattice circumference / m", c);
+  invalidateIndices();
 }
 
 
@@ -133,22 +198,58 @@ void AccLattice::setCircumference(double c)
 // get rotation angle [0,2pi]: increases lin. in bending dipoles, constant in-between. 
 double AccLattice::theta(double posIn) const
 {
-  double theta = 0.;
-  // sum theta of all bending dipoles that end is at a pos < posIn
-  for (auto it=begin<dipole>(); (it!=end() && it.pos(Anchor::end)<posIn); ++it) {
-    theta += it.element()->length * it.element()->k0.z; // theta= l/R = l*k0.z
+  if (!thetaIndexValid)
+    buildThetaIndex();
+  // number of bending dipoles that end is at a pos < posIn
+  unsigned int n = std::lower_bound(thetaEnd.begin(), thetaEnd.end(), posIn) - thetaEnd.begin();
+  return theta(posIn, n);
+}
+
+// theta() for many positions. For ascending positions the dipole index is advanced instead of searched.
+vector<double> AccLattice::theta(const vector<double> &posIn) const
+{
+  if (!thetaIndexValid)
+    buildThetaIndex();
+  vector<double> out(posIn.size());
+  unsigned int n = 0;
+  for (unsigned int i=0; i<posIn.size(); i++) {
+    if (i==0 || posIn[i] < posIn[i-1])
+      n = std::lower_bound(thetaEnd.begin(), thetaEnd.end(), posIn[i]) - thetaEnd.begin();
+    else
+      while (n < thetaEnd.size() && thetaEnd[n] < posIn[i]) n++;
+    out[i] = theta(posIn[i], n);
   }
+  return out;
+}
+
+// n = number of bending dipoles that end is at a pos < posIn
+double AccLattice::theta(double posIn, unsigned int n) const
+{
+  // sum theta of all bending dipoles that end is at a pos < posIn
+  double theta = (n>0) ? thetaSum[n-1] : 0.;
   // if posIn is inside a dipole, add theta of this magnet up to posIn
-  try {
-    auto atPosIn = at(posIn); // throws if there is no element
-    if (atPosIn.element()->type == dipole) {
-      theta += (posIn - atPosIn.pos(Anchor::begin)) * atPosIn.element()->k0.z;
-    }
-  }
-  catch (noMatchingElement) {}
+  if (n < thetaEnd.size() && posIn >= thetaBegin[n])
+    theta += (posIn - thetaBegin[n]) * thetaK0z[n];
   return theta;
 }
 
+void AccLattice::buildThetaIndex() const
+{
+  std::lock_guard<std::recursive_mutex> lock(indexMutex);
+  if (thetaIndexValid) // built by other thread
+    return;
+  thetaBegin.clear(); thetaEnd.clear(); thetaK0z.clear(); thetaSum.clear();
+  double theta = 0.;
+  for (auto it=begin<dipole>(); it!=end(); ++it) {
+    theta += it.element()->length * it.element()->k0.z; // theta= l/R = l*k0.z
+    thetaBegin.push_back(it.pos(Anchor::begin));
+    thetaEnd.push_back(it.pos(Anchor::end));
+    thetaK0z.push_back(it.element()->k0.z);
+    thetaSum.push_back(theta);
+  }
+  thetaIndexValid = true;
+}
+
 
 
 // get here=begin/center/end (in meter) of obj at reference-position pos
@@ -183,35 +284,35 @@ const AccElement* AccLattice::operator[](double pos) const
     throw palatticeError(msg.str());
   }
 
-  try {
-    return at(pos).element();
-  }
+  auto it = find(pos);
+  if (it != end())
+    return it.element();
   // otherwise pos not inside any element:
-  catch (noMatchingElement &e) {
-    return empty_space;
-  }
+  return empty_space;
 }
 
 
 
 AccLattice::const_iterator AccLattice::begin(element_type t, element_plane p, element_family f) const
 {
-  auto it=begin();
-  for (; it!=end(); ++it) {
-    if ( it.element()->type==t && (p==noplane || it.element()->plane==p) && (f==nofamily || it.element()->family==f) )
-      break;
+  auto &list = typeIndex(t);
+  for (unsigned int i=0; i<list.size(); i++) {
+    if (const_iterator::match(list[i]->second,t,p,f)) {
+      auto it = const_iterator(list[i],elements.get(),&refPos,&circ,this);
+      it.typeIndexHint = i;
+      return it;
+    }
   }
-  return it;
+  return end();
 }
 
 // get iterator by name, throws noMatchingElement if name is not found
 // ! name can be ambiguous! always returns first match
 AccLattice::const_iterator AccLattice::operator[](string _name) const
 {
-  for (auto it=begin(); it!=end(); ++it) {
-    if (it.element()->name == _name)
-      return it;
-  }
+  auto it = findName(_name);
+  if (it != elements->end())
+    return const_iterator(it,elements.get(),&refPos,&circ,this);
   // otherwise name does not match any element:
   throw noMatchingElement("No element "+_name+" found");
 }
@@ -225,55 +326,300 @@ AccLattice::const_iterator AccLattice::at(double pos) const
   // | begin  |          X         |                  |
   // | center |          X         |        X         |
   // | end    |                    |        X         |
-   auto it = const_iterator(elements.upper_bound(pos),&elements,&refPos,&circ);
-   if (it!=end() && it.at(pos))
-     return it;
-   --it;
-   if (it.at(pos))
-     return it;
-   
+  return at(pos, upper_bound(pos));
+}
+
+// at(pos) with given ub=upper_bound(pos)
+AccLattice::const_iterator AccLattice::at(double pos, AccMap::const_iterator ub) const
+{
+  auto it = find(pos, ub);
+  if (it != end())
+    return it;
+
   std::stringstream s;
   s << "no element at " << pos << " m";
   throw noMatchingElement(s.str());
 }
 
-// get iterator to next element with "anchor" behind given position
-AccLattice::const_iterator AccLattice::behind(double pos, Anchor anchor) const
+// get iterator by position, end() if pos is in Drift
+AccLattice::const_iterator AccLattice::find(double pos) const
 {
-  try {
-    auto it = at(pos);
-    if (it.pos(anchor) > pos)
+  return find(pos, upper_bound(pos));
+}
+
+// find(pos) with given ub=upper_bound(pos) (candidates see at(pos))
+AccLattice::const_iterator AccLattice::find(double pos, AccMap::const_iterator ub) const
+{
+  auto it = const_iterator(ub,elements.get(),&refPos,&circ,this);
+  if (it!=end() && it.at(pos))
+    return it;
+  if (it!=begin()) {
+    --it;
+    if (it.at(pos))
       return it;
-    else
-      return ++it;
   }
-  catch (noMatchingElement) {
-    return const_iterator(elements.upper_bound(pos),&elements,&refPos,&circ);
+  return end();
+}
+
+// get iterator to next element with "anchor" behind given position, end() if none
+AccLattice::const_iterator AccLattice::findBehind(double pos, Anchor anchor) const
+{
+  auto ub = upper_bound(pos);
+  auto it = find(pos, ub);
+  if (it == end())
+    return const_iterator(ub,elements.get(),&refPos,&circ,this);
+  if (it.pos(anchor) > pos)
+    return it;
+  else
+    return ++it;
+}
+
+
+// position index: bucket b covers [b*width, (b+1)*width) and stores elements.upper_bound(b*width).
+// number of buckets is twice the number of elements, so only few elements have to be skipped per lookup.
+void AccLattice::buildPosIndex() const
+{
+  std::lock_guard<std::recursive_mutex> lock(indexMutex);
+  if (posIndexValid) // built by other thread
+    return;
+  posIndex.clear();
+  if (elements->size()>0 && circ > 0.) {
+    unsigned int n = 2*elements->size();
+    posIndexWidth = circ / n;
+    posIndex.reserve(n);
+    auto it = elements->begin();
+    for (unsigned int b=0; b<n; b++) {
+      double bucketBegin = b*posIndexWidth;
+      while (it!=elements->end() && it->first <= bucketBegin)
+	++it;
+      posIndex.push_back(it);
+    }
+  }
+  posIndexValid = true;
+}
+
+// same as elements.upper_bound(pos), uses position index if enabled
+AccMap::const_iterator AccLattice::upper_bound(double pos) const
+{
+  if (!posIndexOn)
+    return elements->upper_bound(pos);
+  if (!posIndexValid)
+    buildPosIndex();
+  if (posIndex.empty() || !(pos >= 0.) || pos >= circ)
+    return elements->upper_bound(pos);
+
+  unsigned int b = pos / posIndexWidth;
+  if (b >= posIndex.size()) b = posIndex.size()-1;
+  if (b > 0 && b*posIndexWidth > pos) b--; // rounding: bucket begin must be <= pos
+  auto it = posIndex[b];
+  while (it!=elements->end() && it->first <= pos)
+    ++it;
+  return it;
+}
+
+
+// type index
+const std::vector<AccMap::iterator>& AccLattice::typeIndex(element_type t) const
+{
+  if (!typeIndexValid) {
+    std::lock_guard<std::recursive_mutex> lock(indexMutex);
+    if (!typeIndexValid) {
+      // elements are not modified here, but non-const map iterators are stored for non-const type iterators
+      AccMap& e = const_cast<AccMap&>(*elements);
+      typeIndexLists.assign(drift+1, std::vector<AccMap::iterator>());
+      for (auto it=e.begin(); it!=e.end(); ++it)
+	typeIndexLists[it->second->type].push_back(it);
+      typeIndexValid = true;
+    }
   }
+  return typeIndexLists[t];
+}
+
+
+// build all indices, which are otherwise built lazily during const access (guarded by indexMutex).
+// afterwards const member functions do not modify the lattice (until next mount/dismount/write access)
+void AccLattice::buildIndices() const
+{
+  if (posIndexOn && !posIndexValid)
+    buildPosIndex();
+  typeIndex(drift);
+  if (!thetaIndexValid)
+    buildThetaIndex();
+  updateNameIndex();
+}
+
+// tabulate rfFactor(turn) of all RF magnets, e.g. before field calculation for many samples and turns.
+// the table is valid as long as RF parameters of the elements are unchanged.
+RfFactorTable AccLattice::rfFactorTable(unsigned int firstTurn, unsigned int lastTurn) const
+{
+  RfFactorTable table(firstTurn, lastTurn);
+  for (const_iterator it=begin(); it!=end(); ++it)
+    table.add(it.element());
+  return table;
+}
+
+
+// copy-on-write
+// new elements map (copy of m). each element is retained by the map and released, when the map is deleted
+std::shared_ptr<AccMap> AccLattice::newMap(const AccMap &m)
+{
+  for (auto &e : m)
+    AccElementPool::retain(e.second);
+  return std::shared_ptr<AccMap>(new AccMap(m), [](AccMap* p) {
+      for (auto &e : *p)
+	AccElementPool::release(e.second);
+      delete p;
+    });
+}
+
+// own copy of the elements map, if it is shared with copies of this lattice.
+// map iterators (and all indices) are invalid afterwards.
+void AccLattice::detach()
+{
+  if (elements.use_count() <= 1)
+    return;
+  elements = newMap(*elements);
+  invalidateIndices();
+  nameIndexValid = false;
+}
+
+// non-const access to element at it.
+// The element is copied to the own pool, if it is used by other lattices.
+// it can be from a shared or former map, if the lattice was copied after it was obtained -> detach and find again.
+AccElement* AccLattice::writeAccess(AccMap::iterator &it, AccMap* &map)
+{
+  if (map != elements.get() || elements.use_count() > 1) {
+    double pos = it->first;
+    detach();
+    it = elements->find(pos);
+    map = elements.get();
+    if (it == elements->end()) {
+      stringstream msg;
+      msg << "ERROR: AccLattice::writeAccess(): no element at " << pos << " m. Iterator is invalid after dismount.";
+      throw palatticeError(msg.str());
+    }
+  }
+  invalidateElementData();
+  AccElement* e = it->second;
+  if (AccElementPool::useCount(e) > 1) {
+    it->second = e->clone(*pool);
+    release(e);
+  }
+  nameIndexWriteAccess(it);
+  return it->second;
+}
+
+
+// name index
+void AccLattice::buildNameIndex() const
+{
+  std::lock_guard<std::recursive_mutex> lock(indexMutex);
+  nameIndex.clear();
+  nameIndexPending.clear();
+  nameIndexDirty = false;
+  nameIndex.reserve(elements->size());
+  for (auto it=elements->begin(); it!=elements->end(); ++it)
+    nameIndex.emplace(it->second->name, it);
+  nameIndexValid = true;
+}
+
+// insert pending elements (after write access) with their current names
+void AccLattice::updateNameIndex() const
+{
+  if (nameIndexValid && !nameIndexDirty)
+    return;
+  std::lock_guard<std::recursive_mutex> lock(indexMutex);
+  if (!nameIndexValid) {
+    buildNameIndex();
+    return;
+  }
+  for (double pos : nameIndexPending) {
+    AccMap::const_iterator it = elements->find(pos);
+    nameIndex.emplace(it->second->name, it);
+  }
+  nameIndexPending.clear();
+  nameIndexDirty = false;
+}
+
+void AccLattice::nameIndexInsert(AccMap::const_iterator it)
+{
+  if (nameIndexValid)
+    nameIndex.emplace(it->second->name, it);
+}
+
+void AccLattice::nameIndexErase(AccMap::const_iterator it)
+{
+  if (!nameIndexValid || nameIndexPending.erase(it->first) > 0)
+    return;
+  auto range = nameIndex.equal_range(it->second->name);
+  for (auto r=range.first; r!=range.second; ++r) {
+    if (r->second == it) {
+      nameIndex.erase(r);
+      return;
+    }
+  }
+}
+
+// element at it can be renamed: remove entry (with the name before write access) until next lookup
+void AccLattice::nameIndexWriteAccess(AccMap::const_iterator it)
+{
+  if (!nameIndexValid || nameIndexPending.count(it->first) > 0)
+    return;
+  nameIndexErase(it);
+  nameIndexPending.insert(it->first);
+  nameIndexDirty = true;
+}
+
+// first element (lowest position) with given name, elements.end() if none
+AccMap::const_iterator AccLattice::findName(const string& name) const
+{
+  updateNameIndex();
+
+  AccMap::const_iterator first = elements->cend();
+  auto range = nameIndex.equal_range(name);
+  for (auto r=range.first; r!=range.second; ++r) {
+    if (first == elements->cend() || r->second->first < first->first)
+      first = r->second;
+  }
+  return first;
 }
 
 
 // non-const implementations:
-// no duplication: call const_iterator implementation, loop iterator and 
-// compare to result of const_iterator implementation (uses cast iterator -> const_iterator)
-// [no dirty trick to cast from const_iterator to iterator, but slower]
+// no duplication: call const_iterator implementation and convert result to iterator.
+// erase of an empty range does nothing, but returns an iterator (constant time)
+// (if the map is shared, result is from the shared map -> detach and find result.pos() in own map)
 AccLattice::iterator AccLattice::cast_helper(const const_iterator& result)
 {
-  iterator it=begin();
-  std::advance( it, std::distance(const_iterator(it), result) );
+  if (elements.use_count() > 1) {
+    bool isEnd = result.isEnd();
+    double pos = isEnd ? 0. : result.pos();
+    detach();
+    return iterator(isEnd ? elements->end() : elements->find(pos),elements.get(),&refPos,&circ,this);
+  }
+  auto it = iterator(elements->erase(result.it,result.it),elements.get(),&refPos,&circ,this);
+  it.typeIndexHint = result.typeIndexHint;
   return it;
 }
 AccLattice::iterator AccLattice::begin(element_type t, element_plane p, element_family f) {
+  detach();
   return cast_helper(const_cast<const AccLattice*>(this)->begin(t,p,f));
 }
 AccLattice::iterator AccLattice::operator[](string _name) {
+  detach();
   return cast_helper(const_cast<const AccLattice*>(this)->operator[](_name));
 }
 AccLattice::iterator AccLattice::at(double pos) {
+  detach();
   return cast_helper(const_cast<const AccLattice*>(this)->at(pos));
 }
-AccLattice::iterator AccLattice::behind(double pos, Anchor anchor) {
-  return cast_helper(const_cast<const AccLattice*>(this)->behind(pos,anchor));
+AccLattice::iterator AccLattice::find(double pos) {
+  detach();
+  return cast_helper(const_cast<const AccLattice*>(this)->find(pos));
+}
+AccLattice::iterator AccLattice::findBehind(double pos, Anchor anchor) {
+  detach();
+  return cast_helper(const_cast<const AccLattice*>(this)->findBehind(pos,anchor));
 }
 
 
@@ -285,7 +631,7 @@ AccLattice::iterator AccLattice::behind(double pos, Anchor anchor) {
 void AccLattice::mount(double pos, const AccElement& obj, bool verbose)
 {
   //ignoreList
-  if ( obj.nameMatch(ignoreList) ) {
+  if ( ignoreMatcher.match(obj.name) ) {
     ignoreCounter++;
     //metadata
     stringstream ignore;
@@ -307,30 +653,36 @@ void AccLattice::mount(double pos, const AccElement& obj, bool verbose)
     throw palatticeError(msg.str());
   }
 
+  detach();
+
   // empty map (mount first element)
-  if (elements.size() == 0) {
-    elements[pos] = objPtr->clone();
+  if (elements->size() == 0) {
+    (*elements)[pos] = objPtr->clone(*pool);
+    invalidateIndices();
+    nameIndexInsert(elements->begin());
     if (verbose) cout << objPtr->name << " inserted." << endl;
     return;
   }
 
   //"first element whose key goes after pos"
-  auto next = iterator(elements.upper_bound(pos),&elements,&refPos,&circ);
+  auto next = iterator(elements->upper_bound(pos),elements.get(),&refPos,&circ,this);
   auto previous = next;
+  auto existing = elements->end(); // possibly existing element at pos (is replaced)
   if (next == begin())
     first_element = true;
-  else
+  else {
     previous--;
+    if (previous.pos() == pos) {
+      existing = previous.it;
+      if (previous == begin())
+	first_element = true;
+      else
+	previous--;
+    }
+  }
   if (next == end()) //"past-the-end element"
     last_element = true;
 
- 
-  // try deleting possibly existing element at pos
-  try{
-    delete elements.at(pos);
-  }
-  catch(std::out_of_range &e){ }
-
   // avoid numerical problems when checking for "free space"
   if (!first_element && abs(newBegin - previous.end()) < ZERO_DISTANCE) {
     newBegin += ZERO_DISTANCE;
@@ -345,16 +697,27 @@ void AccLattice::mount(double pos, const AccElement& obj, bool verbose)
   }
   else if (!first_element &&  newBegin < previous.end()) {
     msg << objPtr->name << " (" << newBegin <<" - "<< newEnd << "m)";
-    msg2 << previous.element()->name << " ("<< previous.begin() <<" - "<< previous.end() << "m)";
+    msg2 << (*previous)->name << " ("<< previous.begin() <<" - "<< previous.end() << "m)";
     throw noFreeSpace(msg.str(), msg2.str());
   }
   else if (!last_element && newEnd > next.begin()) {
     msg << objPtr->name << " (" << newBegin <<" - "<< newEnd << "m)";
-    msg2 << next.element()->name << " ("<< next.begin() <<" - " << next.end() << "m)";
+    msg2 << (*next)->name << " ("<< next.begin() <<" - " << next.end() << "m)";
     throw noFreeSpace(msg.str(), msg2.str());
   }
   //if there is free space:
-  else elements[pos] = objPtr->clone();
+  else {
+    AccElement* newElement = objPtr->clone(*pool);
+    if (existing != elements->end()) {
+      nameIndexErase(existing);
+      release(existing->second);
+    }
+    else
+      existing = elements->insert(next.it, AccMap::value_type(pos,NULL));
+    existing->second = newElement;
+    invalidateIndices();
+    nameIndexInsert(existing);
+  }
 
   // update circumference
   if (newEnd > circumference())
@@ -365,16 +728,145 @@ void AccLattice::mount(double pos, const AccElement& obj, bool verbose)
 }
 
 
+// mount many elements at once. Result is the same as mount() for each element in given order,
+// but elements are sorted once and free space is checked in one pass over new and existing elements.
+// Nothing is mounted if any element does not fit (throws noFreeSpace).
+void AccLattice::mountBatch(const vector<pair<double,const AccElement*>> &batch, bool verbose)
+{
+  mountBatch_helper(batch, verbose, false);
+}
+
+// adopt=true: elements of batch are created in own pool and mounted without copy (the map retains them)
+void AccLattice::mountBatch_helper(const vector<pair<double,const AccElement*>> &batch, bool verbose, bool adopt)
+{
+  struct Interval {
+    double pos;
+    const AccElement* obj;
+    double begin;
+    double end;
+    bool isNew;
+    string print() const {stringstream s; s << obj->name << " (" << begin <<" - "<< end << "m)"; return s.str();}
+  };
+  vector<Interval> in;
+  in.reserve(batch.size());
+
+  unsigned int ignored = 0;
+  for (auto &b : batch) {
+    if (ignoreMatcher.match(b.second->name)) {
+      ignored++;
+      continue;
+    }
+    if (b.first < 0.) {
+      stringstream msg;
+      msg << "ERROR: AccLattice::mountBatch(): Position of Lattice elements must be > 0. " << b.first << " is not." <<endl;
+      throw palatticeError(msg.str());
+    }
+    in.push_back({b.first, b.second, locate(b.first,b.second,Anchor::begin), locate(b.first,b.second,Anchor::end), true});
+  }
+
+  // sort by position. for equal positions only the last element is mounted (as with mount())
+  auto byPos = [](const Interval &a, const Interval &b) {return a.pos < b.pos;};
+  if (!std::is_sorted(in.begin(), in.end(), byPos))
+    std::stable_sort(in.begin(), in.end(), byPos);
+  unsigned int n = 0;
+  for (unsigned int i=0; i<in.size(); i++) {
+    if (i+1 < in.size() && in[i+1].pos == in[i].pos)
+      continue;
+    in[n++] = in[i];
+  }
+  in.resize(n);
+
+  detach();
+
+  // check for "free space": walk new and existing elements by position
+  // (existing elements at the position of a new one are replaced and not checked)
+  // overlap smaller than ZERO_DISTANCE is allowed (see mount())
+  auto ex = elements->cbegin();
+  Interval prev, cur;
+  bool first = true;
+  for (unsigned int i=0; i<in.size() || ex!=elements->cend(); first=false, prev=cur) {
+    if (ex!=elements->cend() && (i>=in.size() || ex->first < in[i].pos)) {
+      cur = {ex->first, ex->second, locate(ex->first,ex->second,Anchor::begin), locate(ex->first,ex->second,Anchor::end), false};
+      ++ex;
+      if (!first && !prev.isNew)
+	continue;
+    }
+    else {
+      if (ex!=elements->cend() && ex->first == in[i].pos)
+	++ex;
+      cur = in[i++];
+      if (cur.begin < 0.)
+	throw noFreeSpace(cur.print(), "lattice begin at 0.0m");
+    }
+    if (!first && prev.end - cur.begin >= ZERO_DISTANCE) {
+      if (cur.isNew) throw noFreeSpace(cur.print(), prev.print());
+      else throw noFreeSpace(prev.print(), cur.print());
+    }
+  }
+
+  // mount
+  double maxEnd = circumference();
+  for (auto &e : in) {
+    auto it = (elements->empty() || e.pos > elements->rbegin()->first) ? elements->end() : elements->lower_bound(e.pos);
+    AccElement* newElement;
+    if (adopt) {
+      newElement = const_cast<AccElement*>(e.obj);
+      AccElementPool::retain(newElement);
+    }
+    else
+      newElement = e.obj->clone(*pool);
+    if (it != elements->end() && it->first == e.pos) {
+      nameIndexErase(it);
+      release(it->second);
+    }
+    else
+      it = elements->insert(it, AccMap::value_type(e.pos,NULL));
+    it->second = newElement;
+    nameIndexInsert(it);
+    if (e.end > maxEnd) maxEnd = e.end;
+    if (verbose) cout << e.obj->name << " inserted." << endl;
+  }
+  invalidateIndices();
+
+  // update circumference
+  if (maxEnd > circumference())
+    setCircumference(maxEnd);
+
+  if (ignored > 0) {
+    ignoreCounter += ignored;
+    //metadata
+    stringstream ignore;
+    ignore << ignoreCounter;
+    info.add("ignored elements", ignore.str());
+  }
+}
+
+// mountBatch() for elements created during import in own pool. they are mounted without copy,
+// elements that are not mounted (ignored, replaced or exception) are released with the batch.
+void AccLattice::mountImported(const ImportBatch &batch)
+{
+  vector<pair<double,const AccElement*>> b;
+  b.reserve(batch.size());
+  for (auto &e : batch)
+    b.push_back(make_pair(e.first, e.second.get()));
+  mountBatch_helper(b, false, true);
+}
+
+
 // dismount element at position pos
 void AccLattice::dismount(double pos)
 {
-  auto it =  elements.find(pos);
+  detach();
+  auto it =  elements->find(pos);
 
-  if (it == elements.end()) {
+  if (it == elements->end()) {
     cout << "WARNING: AccLattice::dismount(): There is no element at position "<<pos<< " m. Nothing is dismounted." << endl;
     return;
   }
-  elements.erase(it);
+  nameIndexErase(it);
+  release(it->second);
+  elements->erase(it);
+  invalidateIndices();
 }
 
 
@@ -397,6 +889,7 @@ void AccLattice::setIgnoreList(string ignoreFile)
   while (!f.eof()) {
     f >> tmp;
     ignoreList.push_back(tmp);
+    ignoreMatcher.add(tmp);
   }
 
   //metadata
@@ -467,8 +960,10 @@ void AccLattice::madximport(SimToolInstance &madx)
 
 
   //mount elements
-  AccElement *element;
+  ElementPtr element;
   double s=0.;
+  ImportBatch batch;
+  batch.reserve(twi.rows());
   for (unsigned int i=0; i<twi.rows(); i++) {
     string key = twi.gets(i,"KEYWORD");
     string name = removeQuote(twi.gets(i,"NAME"));
@@ -478,40 +973,40 @@ void AccLattice::madximport(SimToolInstance &madx)
     double vkick = twi.getd(i,"VKICK");
 
     if (key == "\"SBEND\"" || key == "\"RBEND\"") {  //horizontal bending Dipole (assume all bends have vertical field)
-      element = new Dipole(name, l, H);
+      element.reset(pool->make<Dipole>(name, l, H));
     }
     else if (key == "\"QUADRUPOLE\"") {
-      element = new Quadrupole(name, l, F);
+      element.reset(pool->make<Quadrupole>(name, l, F));
     }
     else if (key == "\"SEXTUPOLE\"") {
-      element = new Sextupole(name, l, F);
+      element.reset(pool->make<Sextupole>(name, l, F));
     }
     else if (key == "\"VKICKER\"") {
-      element = new Corrector(name, l,V);
+      element.reset(pool->make<Corrector>(name, l,V));
     }
     else if (key == "\"HKICKER\"") {
-      element = new Corrector(name, l,H);
+      element.reset(pool->make<Corrector>(name, l,H));
     }
     else if (key == "\"KICKER\"") {
-      element = new Corrector(name, l);
+      element.reset(pool->make<Corrector>(name, l));
     }
     else if (key == "\"RFCAVITY\"") {
-      element = new Cavity(name, l);
+      element.reset(pool->make<Cavity>(name, l));
     }
     else if (key == "\"MULTIPOLE\"") {
-      element = new Multipole(name, l);
+      element.reset(pool->make<Multipole>(name, l));
     }
     else if (key == "\"MARKER\"") {
-      element = new Marker(name);
+      element.reset(pool->make<Marker>(name));
     }
     else if (key == "\"MONITOR\"") {
-      element = new Monitor(name, l);
+      element.reset(pool->make<Monitor>(name, l));
     }
     else if (key == "\"RCOLLIMATOR\"") {
-      element = new Rcollimator(name, l);
+      element.reset(pool->make<Rcollimator>(name, l));
     }
     else if (key == "\"SOLENOID\"") {
-      element = new Solenoid(name, l);
+      element.reset(pool->make<Solenoid>(name, l));
     }
     else continue; //Drifts are not mounted explicitly
     
@@ -542,9 +1037,9 @@ void AccLattice::madximport(SimToolInstance &madx)
     s = twi.getd(i,"S");
     if (refPos == Anchor::begin) s -= l;
     else if (refPos == Anchor::center) s -= l/2;
-    this->mount(s, *element);
-    delete element;
+    batch.push_back(make_pair(s, std::move(element)));
   }
+  mountImported(batch);
 
   // import misalignments
   this->madximportMisalignments(dipole, madx.outFile("dipealign"));
@@ -579,17 +1074,27 @@ void AccLattice::madximportMisalignments(element_type t, string madxEalignFile)
   SimToolTable ealign;
   ealign = madx.readTable(madxEalignFile, {"NAME", "DPSI", "DX", "DY"});
 
-  //set misalignments to AccLattice elements
+  //index ealign rows by element name
+  std::unordered_map<string, vector<unsigned int>> rows;
+  for (unsigned int i=0; i<ealign.rows(); i++)
+    rows[removeQuote(ealign.gets(i,"NAME"))].push_back(i);
+
+  //set misalignments to AccLattice elements (all rows with matching name)
   string type = "-";
-  for (auto ele : *this) {
-    for (unsigned int i=0; i<ealign.rows(); i++) {
-      if (ele->type==t && ele->name==removeQuote(ealign.gets(i,"NAME"))) {
-	ele->tilt += - ealign.getd(i,"DPSI");    // <<<<<<!!! sign of rotation angle (see comment above)
-	ele->displacement.x += ealign.getd(i,"DX");
-	ele->displacement.z += ealign.getd(i,"DY");
-	type = ele->type_string();
-      }
+  const AccLattice* self = this;
+  for (const_iterator it=self->begin(t); it!=self->end(); it.next(t)) {
+    auto match = rows.find((*it)->name);
+    if (match == rows.end())
+      continue;
+    auto w = cast_helper(it);
+    it = w;
+    AccElement* ele = w.modify();
+    for (unsigned int i : match->second) {
+      ele->tilt += - ealign.getd(i,"DPSI");    // <<<<<<!!! sign of rotation angle (see comment above)
+      ele->displacement.x += ealign.getd(i,"DX");
+      ele->displacement.z += ealign.getd(i,"DY");
     }
+    type = ele->type_string();
   }
 
   //metadata
@@ -643,6 +1148,7 @@ void AccLattice::elegantimport(SimToolInstance &elegant)
   // 	 << "They are transformed to the current Anchor set for this lattice: " << refPos_string() << endl;
 
   SimToolTable tab = elegant.readTable(elegant.lattice(), {"ElementName", "ElementParameter", "ParameterValue", "ElementType"});
+  ImportBatch batch;
   
   for (auto i=0u; i<tab.rows(); i++) {
     row.name = tab.gets(i, "ElementName");
@@ -657,7 +1163,7 @@ void AccLattice::elegantimport(SimToolInstance &elegant)
 
     //mount element if next element reached (=all parameters read)
     if (row.name != row_old.name) {
-      elegantimport_mount(s, row_old, params, l);
+      elegantimport_mount(s, row_old, params, l, batch);
      // clear param. values to avoid reuse of an old value
      l=0.;
      resetParams(params);
@@ -674,7 +1180,8 @@ void AccLattice::elegantimport(SimToolInstance &elegant)
    row_old = row;
   }
   // mount last element
-  elegantimport_mount(s, row_old, params, l);
+  elegantimport_mount(s, row_old, params, l, batch);
+  mountImported(batch);
   
   //info stdout
   cout << this->sizeSummary() << endl
@@ -684,53 +1191,53 @@ void AccLattice::elegantimport(SimToolInstance &elegant)
   }
 }
 
-// helper function for elegantimport(): create AccElement from imported parameters and mount in lattice
-void AccLattice::elegantimport_mount(const double& s, paramRow& row_old, const paramMap& params, const double& l)
+// helper function for elegantimport(): create AccElement from imported parameters and add it to batch (to be mounted in lattice)
+void AccLattice::elegantimport_mount(const double& s, paramRow& row_old, const paramMap& params, const double& l, ImportBatch &batch)
 {
-     AccElement *element;
+     ElementPtr element;
   
      if (row_old.type=="CSBEND" || row_old.type=="CSRCSBEND" || row_old.type=="KSBEND" || row_old.type=="NIBEND" || row_old.type=="TUBEND" || row_old.type=="SBEN") {
-       element = new Dipole(row_old.name, l, H);
+       element.reset(pool->make<Dipole>(row_old.name, l, H));
      }
      else if (row_old.type=="QUAD" || row_old.type=="KQUAD") {
-       element = new Quadrupole(row_old.name, l, F);
+       element.reset(pool->make<Quadrupole>(row_old.name, l, F));
      }
      else if (row_old.type=="SEXT" || row_old.type=="KSEXT") {
-       element = new Sextupole(row_old.name, l, F);
+       element.reset(pool->make<Sextupole>(row_old.name, l, F));
      }
      else if (row_old.type=="VKICK") {
-       element = new Corrector(row_old.name, l, V);
+       element.reset(pool->make<Corrector>(row_old.name, l, V));
        double kick = params.at("KICK");
        if (kick!=0.)  element->setVkick_rad(kick); // 1/R from kick angle, straight length l
      }
      else if (row_old.type=="HKICK") {
-       element = new Corrector(row_old.name, l, H);
+       element.reset(pool->make<Corrector>(row_old.name, l, H));
        double kick = params.at("KICK");
        if (kick!=0.)  element->setHkick_rad(kick);
      }
      else if (row_old.type=="KICKER") {
-       element = new Corrector(row_old.name, l);
+       element.reset(pool->make<Corrector>(row_old.name, l));
        element->setVkick_rad(params.at("VKICK"));
        element->setHkick_rad(params.at("HKICK"));
      }
      else if (row_old.type=="RFCA") {
-       element = new Cavity(row_old.name, l);
+       element.reset(pool->make<Cavity>(row_old.name, l));
      }
      else if (row_old.type=="MARK") {
-       element = new Marker(row_old.name);
+       element.reset(pool->make<Marker>(row_old.name));
      }
      else if (row_old.type=="MONI") {
-       element = new Monitor(row_old.name, l);
+       element.reset(pool->make<Monitor>(row_old.name, l));
      }
      else if (row_old.type=="RCOL") {
-       element = new Rcollimator(row_old.name, l);
+       element.reset(pool->make<Rcollimator>(row_old.name, l));
      }
      else if (row_old.type=="SOLE") {
-       element = new Solenoid(row_old.name, l);
+       element.reset(pool->make<Solenoid>(row_old.name, l));
        element->k0.s += params.at("KS");
      }
      else
-       element = new Drift(); //Drifts are not mounted explicitly
+       return; //Drifts are not mounted explicitly
      
      // rf magnet
      // if (row_old.name.substr(0,6) == "RFDIP.") {
@@ -738,30 +1245,27 @@ void AccLattice::elegantimport_mount(const double& s, paramRow& row_old, const p
      //   element->dQrf = 5.402e-6;
      // }
 
-     if (element->type != drift) {
-       double angle = params.at("ANGLE");
-       if (angle!=0.) element->k0.z += angle / l; // 1/R from bending angle, curved length l
-       element->k1 = params.at("K1");
-       element->k2 = params.at("K2");
-       element->tilt = params.at("TILT");
-       element->displacement.x = params.at("DX");
-       element->displacement.z = params.at("DY");
-       element->e1 = params.at("E1");
-       element->e2 = params.at("E2");
-       element->halfWidth.x = params.at("X_MAX");
-       element->halfWidth.z = params.at("Y_MAX");
-       if (element->type == cavity) {
-	 element->volt = params.at("VOLT");
-	 element->freq = params.at("FREQ");
-       }
-
-       double pos;
-       if (refPos == Anchor::begin) pos = s-l;
-       else if (refPos == Anchor::center) pos = s-l/2;
-       else pos = s; 
-       this->mount(pos, *element); // mount element
+     double angle = params.at("ANGLE");
+     if (angle!=0.) element->k0.z += angle / l; // 1/R from bending angle, curved length l
+     element->k1 = params.at("K1");
+     element->k2 = params.at("K2");
+     element->tilt = params.at("TILT");
+     element->displacement.x = params.at("DX");
+     element->displacement.z = params.at("DY");
+     element->e1 = params.at("E1");
+     element->e2 = params.at("E2");
+     element->halfWidth.x = params.at("X_MAX");
+     element->halfWidth.z = params.at("Y_MAX");
+     if (element->type == cavity) {
+       element->volt = params.at("VOLT");
+       element->freq = params.at("FREQ");
      }
-     delete element;
+
+     double pos;
+     if (refPos == Anchor::begin) pos = s-l;
+     else if (refPos == Anchor::center) pos = s-l/2;
+     else pos = s; 
+     batch.push_back(make_pair(pos, std::move(element))); // mount element
 }
 
 // init map of used elegant parameters
@@ -817,21 +1321,21 @@ void AccLattice::setELSAoptics(string spurenFolder)
 
   //Write strengths to quads
   for (auto it=begin<quadrupole>(); it!=end(); ++it) {
-    if (it.element()->name.compare(1,2,"QF") == 0) {
-      it.element()->k1 = kf;
+    if ((*it)->name.compare(1,2,"QF") == 0) {
+      it.modify()->k1 = kf;
     }
-    else if (it.element()->name.compare(1,2,"QD") == 0) {
-      it.element()->k1 = -kd;
+    else if ((*it)->name.compare(1,2,"QD") == 0) {
+      it.modify()->k1 = -kd;
     }
   }
 
   //Write strengths to sexts
   for (auto it=begin<sextupole>(); it!=end(); ++it) {
-    if (it.element()->name.compare(1,2,"SF") == 0) {
-      it.element()->k2 = mf;
+    if ((*it)->name.compare(1,2,"SF") == 0) {
+      it.modify()->k2 = mf;
     }
-    else if (it.element()->name.compare(1,2,"SD") == 0) {
-      it.element()->k2 = -md;
+    else if ((*it)->name.compare(1,2,"SD") == 0) {
+      it.modify()->k2 = -md;
     }
   }
 
@@ -869,9 +1373,9 @@ unsigned int AccLattice::setELSACorrectors(ELSASpuren &spuren, unsigned int t)
    //...check by name
    snprintf(name1, 20, "KV%02i", i+1); // old madx-lattice: KVxx
    snprintf(name2, 20, "VC%02i", i+1); // new madx-lattice (2014): VCxx
-   if (it.element()->name != name1 && it.element()->name != name2) {
+   if ((*it)->name != name1 && (*it)->name != name2) {
      strMsg << "ERROR: AccLattice::setELSACorrectors(): Unexpected corrector name. Mad-X lattice does not fit to ELSA." << endl;
-     strMsg << "       Mad-X: " <<it.element()->name<< " -- expected: " <<name2<< " (" <<name1<< ")" << endl;
+     strMsg << "       Mad-X: " <<(*it)->name<< " -- expected: " <<name2<< " (" <<name1<< ")" << endl;
      throw palatticeError(strMsg.str());
    }
    //...check by position
@@ -880,7 +1384,7 @@ unsigned int AccLattice::setELSACorrectors(ELSASpuren &spuren, unsigned int t)
      cout << "! Position of " <<name2<< " differs by " <<diff<< "m in Mad-X and ELSA-Spuren. Use ELSA-Spuren." << endl;
    }
    
-   corrTmp = it.element()->clone();
+   corrTmp = (*it)->clone();
    corrTmp->k0.x = spuren.vcorrs[i].time[t].kick/1000.0/corrTmp->length;   //unit 1/m
    it_next = it;
    ++it_next;
@@ -910,7 +1414,7 @@ unsigned int AccLattice::setELSACorrectors(ELSASpuren &spuren, unsigned int t)
 
 
 // subtract other corrector strengths from the ones of this lattice
-void AccLattice::subtractCorrectorStrengths(AccLattice &other)
+void AccLattice::subtractCorrectorStrengths(const AccLattice &other)
 {
   stringstream msg;
   
@@ -924,9 +1428,9 @@ void AccLattice::subtractCorrectorStrengths(AccLattice &other)
   for  (auto it=begin<pal::corrector>(); it!=end(); ++it) {
 
     // check by name
-    if (otherIt.element()->name != it.element()->name) {
+    if (otherIt.element()->name != (*it)->name) {
       msg << "ERROR: AccLattice::subtractCorrectorStrengths(): Unequal names of correctors to subtract. ("
-	  << it.element()->name <<"/"<< otherIt.element()->name << ").";
+	  << (*it)->name <<"/"<< otherIt.element()->name << ").";
       throw palatticeError(msg.str());
     }
     // check by position
@@ -936,13 +1440,14 @@ void AccLattice::subtractCorrectorStrengths(AccLattice &other)
       throw palatticeError(msg.str());
     }
     // check plane
-    if (otherIt.element()->plane != it.element()->plane) {
+    if (otherIt.element()->plane != (*it)->plane) {
       msg << "ERROR: AccLattice::subtractCorrectorStrengths(): Unequal planes of correctors to subtract.";
       throw palatticeError(msg.str());
     }
 
-    // subtract
-    it.element()->k0 -= otherIt.element()->k0;
+    // subtract (unchanged elements are not copied, see copy-on-write)
+    if (otherIt.element()->k0 != AccTriple())
+      it.modify()->k0 -= otherIt.element()->k0;
     // set otherIt to next corrector
     ++otherIt;
   }
@@ -971,9 +1476,9 @@ void AccLattice::subtractMisalignments(const AccLattice &other)
   for  (auto it=begin(); it!=end(); ++it) {
 
     // check by name
-    if (otherIt.element()->name != it.element()->name) {
+    if (otherIt.element()->name != (*it)->name) {
       msg << "ERROR: AccLattice::subtractMisalignments(): Unequal names of elements to subtract. ("
-	  << it.element()->name <<"/"<< otherIt.element()->name << ").";
+	  << (*it)->name <<"/"<< otherIt.element()->name << ").";
       throw palatticeError(msg.str());
     }
     // check by position
@@ -983,8 +1488,9 @@ void AccLattice::subtractMisalignments(const AccLattice &other)
       throw palatticeError(msg.str());
     }
 
-    // subtract
-    it.element()->tilt -= otherIt.element()->tilt;
+    // subtract (unchanged elements are not copied, see copy-on-write)
+    if (otherIt.element()->tilt != 0.)
+      it.modify()->tilt -= otherIt.element()->tilt;
     // set otherIt to next corrector
     ++otherIt;
   }
@@ -1004,13 +1510,24 @@ void AccLattice::subtractMisalignments(const AccLattice &other)
 // internal variables k1, k2 are not changed.
 void AccLattice::setFamily(const element_family FAMILY, const string& namePattern, const element_type TYPE)
 {
-  iterator it = begin();
+  setFamily(FAMILY, vector<string>(1,namePattern), TYPE);
+}
+
+void AccLattice::setFamily(const element_family FAMILY, const vector<string>& namePatterns, const element_type TYPE)
+{
+  NameMatcher matcher(namePatterns);
+  // const_iterator: only changed elements are copied (copy-on-write)
+  const AccLattice* self = this;
+  const_iterator it = self->begin();
   if (TYPE!=drift)
-    it = begin(TYPE);
+    it = self->begin(TYPE);
 
-  while (it!=end()) {
-    if (it.element()->nameMatch(namePattern))
-      it.element()->family = FAMILY;
+  while (it!=self->end()) {
+    if (it.element()->family != FAMILY && matcher.match(it.element()->name)) {
+      auto w = cast_helper(it);
+      w.modify()->family = FAMILY;
+      it = w;
+    }
     
     if (TYPE==drift)
       ++it;
@@ -1027,12 +1544,15 @@ void AccLattice::setFamily(const element_family FAMILY, const string& namePatter
 // returns number of elements of a type in this lattice
 unsigned int AccLattice::size(element_type _type, element_plane p, element_family f) const
 {
+  auto &list = typeIndex(_type);
+  if (p==noplane && f==nofamily)
+    return list.size();
+
   unsigned int n=0;
-  for (auto it=begin(); it!=end(); ++it) {
-    if (it.element()->type == _type && (p==noplane || it.element()->plane==p) && (f==nofamily || it.element()->family==f))
+  for (auto &it : list) {
+    if (const_iterator::match(it->second,_type,p,f))
       n++;
   }
-
   return n;
 }
 
@@ -1086,17 +1606,68 @@ string AccLattice::refPos_string() const
 // imortant is to keep integral field (along beam axis s) constant!
 // Gauss: f(x) = exp(-0.5*(x*0.67449/d)^2), 50% quantile (median) at 0.67449 sigma
 double AccLattice::slope(double pos, const_iterator it) const
+{
+  const AccElement *e = it.element();
+  return edgeSlope(it.distanceRing(Anchor::begin,pos), it.distanceRing(Anchor::end,pos), e->edgeHalfDl(), e->edgeSigma());
+}
+
+// halfDl: half of dl() at each magnet end, sigma = dl * sqrt(2/pi) = dl * 0.797884561
+double AccLattice::edgeSlope(double distBegin, double distEnd, double halfDl, double sigma)
 {
   double x=1.;
-  double dl = it.element()->dl()/2; // half of dl() at each magnet end
-  double distBegin = it.distanceRing(Anchor::begin,pos) - dl; // distance to phys. begin of it
-  double distEnd = it.distanceRing(Anchor::end,pos) + dl;     // distance to phys. end of it
+  distBegin -= halfDl; // distance to phys. begin
+  distEnd += halfDl;   // distance to phys. end
   if (distBegin < 0) x = distBegin;
   else if (distEnd > 0) x = distEnd;
   else return 1.;
 
-  double sigma = dl * sqrt(2./M_PI); // dl * 0.797884561
-  return exp(-0.5*pow(x/sigma,2));
+  return gaussSlope(x/sigma);
+}
+
+// both directions are checked, shorter distance is returned.
+double AccLattice::ringDistance(double d_normal, double circ)
+{
+  double d_other = circ - fabs(d_normal);
+  if ( d_other >= 0.5 * circ ) // regular direction shorter
+    return d_normal;
+  else {
+    if (d_normal>0)
+      d_other *= -1;
+    return d_other;
+  }
+}
+
+// Gaussian exp(-0.5*u^2) for edge fields.
+// tabulated values and derivatives (cubic Hermite interpolation) with step width
+// h = (128*tol)^(1/4) (interpolation error < h^4/384 * max|f''''| = h^4/384 * 3)
+// up to u_max = sqrt(-2 ln(tol)) (f < tol for larger u)
+double AccLattice::gaussSlope(double u)
+{
+  if (EDGEFIELD_SLOPE_TOLERANCE <= 0.)
+    return exp(-0.5*pow(u,2));
+
+  struct Table {
+    double h, uMax;
+    std::vector<double> f, hdf; // f(u_i), h*f'(u_i)
+    Table() : h(pow(128.*EDGEFIELD_SLOPE_TOLERANCE, 0.25)), uMax(sqrt(-2.*log(EDGEFIELD_SLOPE_TOLERANCE))) {
+      unsigned int n = uMax/h + 2;
+      for (unsigned int i=0; i<n; i++) {
+	double ui = i*h;
+	f.push_back(exp(-0.5*ui*ui));
+	hdf.push_back(-ui*f.back()*h);
+      }
+    }
+  };
+  static const Table table; // initialized once (thread-safe)
+
+  u = fabs(u);
+  if (!(u < table.uMax)) // also for u=inf/nan (zero length edge)
+    return 0.;
+  double t = u/table.h;
+  unsigned int i = t;
+  t -= i;
+  double t2 = t*t, t3 = t2*t;
+  return (2*t3-3*t2+1)*table.f[i] + (t3-2*t2+t)*table.hdf[i] + (-2*t3+3*t2)*table.f[i+1] + (t3-t2)*table.hdf[i+1];
 }
 
 /* EXPERIMENTAL: magnetic field including edge field (with slope)
@@ -1114,20 +1685,189 @@ double AccLattice::slope(double pos, const_iterator it) const
 AccTriple AccLattice::B(double posIn, const AccPair &orbit) const
 {
   double pos = posMod(posIn);
-  unsigned int t = turn(posIn);
   // next magnet with center > pos:
-  const_iterator it = behind(pos,Anchor::center);
+  return B(pos, turn(posIn), findBehind(pos,Anchor::center), orbit);
+}
+
+AccTriple AccLattice::B(const LatticeCursor &cursor, const AccPair &orbit) const
+{
+  return B(cursor.posInTurn(), cursor.turn(), cursor.next(), orbit);
+}
+
+// it = next magnet with center > pos
+// elements without field are skipped, field of magnets is calculated non-virtual (AccElement::field())
+AccTriple AccLattice::B(double pos, unsigned int t, const_iterator it, const AccPair &orbit) const
+{
   AccTriple field;
-  field = it.element()->B_rf(t,orbit) * slope(pos, it); //B_rf includes rf magnets
+  const AccElement *e = it.element();
+  if (e->hasField())
+    field = (e->field().B(orbit) * e->rfFactor(t)) * slope(pos, it); //rfFactor for rf magnets
   // previous magnet (center <= pos):
   if (it == begin()) it = end();
-  --it;                                       
-  field += it.element()->B_rf(t,orbit) * slope(pos, it);
+  --it;
+  e = it.element();
+  if (e->hasField())
+    field += (e->field().B(orbit) * e->rfFactor(t)) * slope(pos, it);
 
   return field;
 }
 
 
+// B() for n positions. consecutive positions between the same two magnets (and in the same turn)
+// are evaluated by one call of AccElement::B() for all their orbit points.
+// results are the same as for B(posIn[i],orbit). rfFactor() is taken from rf, if given.
+void AccLattice::B(const double *posIn, const double *x, const double *z, unsigned int n, AccTriple *out, const RfFactorTable *rf) const
+{
+  LatticeCursor cursor(*this);
+  std::vector<AccTriple> Belement;
+  unsigned int first = 0;
+  while (first < n) {
+    cursor.moveTo(posIn[first]);
+    const_iterator next = cursor.next();
+    unsigned int t = cursor.turn();
+    unsigned int last = first+1;
+    for (; last<n; last++) {
+      cursor.moveTo(posIn[last]);
+      if (cursor.next() != next || cursor.turn() != t)
+	break;
+    }
+    unsigned int m = last-first;
+    const_iterator prev = next;
+    if (prev == begin()) prev = end();
+    --prev;
+
+    std::fill(out+first, out+last, AccTriple());
+    for (const_iterator it : {next, prev}) {
+      const AccElement *e = it.element();
+      if (!e->hasField()) // skip elements without field
+	continue;
+      Belement.resize(m);
+      e->field().B(x+first, z+first, m, Belement.data());
+      double factor = rf ? (*rf)(e,t) : e->rfFactor(t);
+      for (unsigned int i=0; i<m; i++)
+	out[first+i] += (Belement[i] * factor) * slope(posMod(posIn[first+i]), it);
+    }
+    first = last;
+  }
+}
+
+
+// analytic Fourier coefficients c_k = 1/L * integral B(s) exp(-i w_k s) ds, w_k = 2 pi k / L
+// of each magnet with constant field B between begin+dl/2 and end-dl/2 (x1,x0)
+// and Gaussian edge fields exp(-x^2/(2 sigma^2)) at both sides (see slope()):
+// integral_0^inf exp(-x^2/(2 sigma^2)) exp(-+i w x) dx = C -+ i S, with
+//   C = sigma sqrt(pi/2) exp(-(w sigma)^2/2) and S = sqrt(2) sigma Dawson(w sigma/sqrt(2))
+// Edge fields are assumed to vanish before the neighbouring element centers (B() cuts them there).
+Spectrum AccLattice::fieldSpectrum(const std::vector<AccPair> &orbit, unsigned int fmax, AccAxis axis, double ampcut, bool edgefields, string name) const
+{
+  typedef std::complex<double> cplx;
+  const cplx I(0.,1.);
+  std::vector<cplx> c(fmax+1);
+
+  unsigned int i=0;
+  for (const_iterator it=begin(); it!=end(); ++it, ++i) {
+    const AccElement *e = it.element();
+    if (!e->hasField())
+      continue;
+    AccTriple Be = e->field().B(orbit[i]) * e->rfFactor(1);
+    double b = (axis==x) ? Be.x : ((axis==z) ? Be.z : Be.s);
+    if (b == 0.)
+      continue;
+
+    double h = edgefields ? e->edgeHalfDl() : 0.;
+    double sigma = e->edgeSigma();
+    double x1 = it.begin() + h;
+    double x0 = it.begin() + e->length - h;
+    c[0] += b/circ * (x0 - x1 + 2*h); // integral of each edge field is h
+    for (unsigned int k=1; k<=fmax; k++) {
+      double w = 2*M_PI*k/circ;
+      cplx e1 = std::exp(-I*w*x1);
+      cplx e0 = std::exp(-I*w*x0);
+      cplx integral = (e1 - e0) / (I*w);
+      if (h > 0.) {
+	double C = sigma * sqrt(M_PI/2) * exp(-0.5*pow(w*sigma,2));
+	double S = sqrt(2.) * sigma * gsl_sf_dawson(w*sigma/sqrt(2.));
+	integral += e0*(C - I*S) + e1*(C + I*S);
+      }
+      c[k] += b/circ * integral;
+    }
+  }
+
+  // same normalization and phase convention as Spectrum::fft()
+  if (name=="") name = axis_string(axis);
+  Spectrum spec(name, fmax, ampcut);
+  spec.setLength(circ);
+  FREQCOMP comp;
+  comp.amp = std::abs(c[0]);
+  spec.push_back(comp);
+  for (unsigned int k=1; k<=fmax; k++) {
+    comp.freq = k*spec.dFreq();
+    comp.amp = 2*std::abs(c[k]);
+    comp.phase = std::arg(c[k]);
+    if (comp.amp < MIN_AMPLITUDE)
+      comp.phase = 0.;
+    else if (comp.phase < 0.)
+      comp.phase += 2*M_PI;
+    spec.push_back(comp);
+  }
+  spec.info.add("Spectrum calculation", edgefields ? "analytic (with edge fields)" : "analytic (hard edge)");
+  spec.info += this->info;
+  return spec;
+}
+
+// orbit at element centers (interpolation range is clamped) from orbit of turn 1
+Spectrum AccLattice::fieldSpectrum(FunctionOfPos<AccPair> &orbit, unsigned int fmax, AccAxis axis, double ampcut, bool edgefields, string name) const
+{
+  if (circ != orbit.circumference()) {
+    stringstream msg;
+    msg << "ERROR: AccLattice::fieldSpectrum(): lattice and orbit have different circumferences ("
+	<< circ <<", "<< orbit.circumference() <<").";
+    throw palatticeError(msg.str());
+  }
+  std::vector<AccPair> o(size());
+  if (orbit.size() < 2) {
+    cout << "WARNING: AccLattice::fieldSpectrum(): Interpolation of orbit not possible for only " << orbit.size()
+	 << " datapoints. Spectrum is calculated without orbit." << endl;
+  }
+  else {
+    if (!orbit.initialized())
+      orbit.init();
+    unsigned int i=0;
+    for (const_iterator it=begin(); it!=end(); ++it, ++i) {
+      if (it.element()->hasField())
+	o[i] = orbit.interp(std::min(std::max(it.center(), orbit.interpMin()), orbit.interpMax()));
+    }
+  }
+  Spectrum spec = fieldSpectrum(o, fmax, axis, ampcut, edgefields, name);
+  spec.info += orbit.info;
+  return spec;
+}
+
+Spectrum AccLattice::fieldSpectrum(unsigned int fmax, AccAxis axis, double ampcut, bool edgefields, string name) const
+{
+  return fieldSpectrum(std::vector<AccPair>(size()), fmax, axis, ampcut, edgefields, name);
+}
+
+
+LatticeCursor::LatticeCursor(const AccLattice &l)
+  : lattice(&l), nextIt(l.begin()), posIn(0.), pos(0.), t(1)
+{
+  nextIt = lattice->findBehind(pos, Anchor::center);
+}
+
+void LatticeCursor::moveTo(double _posIn)
+{
+  double newPos = lattice->posMod(_posIn);
+  if (newPos < pos) // backwards: lookup
+    nextIt = lattice->findBehind(newPos, Anchor::center);
+  else {            // forwards: advance
+    while (nextIt != lattice->end() && nextIt.pos(Anchor::center) <= newPos)
+      ++nextIt;
+  }
+  posIn = _posIn;
+  pos = newPos;
+  t = lattice->turn(_posIn);
+}
 
 
 
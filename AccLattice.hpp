@@ -21,12 +21,18 @@
 #define __LIBPALATTICE_ACCLATTICE_HPP_
 
 #include <map>
+#include <set>
 #include <unordered_map>
 #include <stdexcept>
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
 #include <iterator>
+#include <algorithm>
 #include "AccElements.hpp"
+#include "NameMatcher.hpp"
 #include "ELSASpuren.hpp"
 #include "Metadata.hpp"
 #include "config.hpp"
@@ -37,6 +43,9 @@ namespace pal
 {
 
   enum class Anchor{begin,center,end};
+  class LatticeCursor;
+  class Spectrum;
+  template <class T> class FunctionOfPos;
   typedef std::map<double,AccElement*> AccMap;
 
   
@@ -46,14 +55,71 @@ namespace pal
     
 protected:
   double circ;
-  AccMap elements;  // first: position in lattice / m
+  // elements (first: position in lattice / m). copy-on-write:
+  // the map is shared with copies of this lattice until non-const access to one of them (detach(), copies pointers only).
+  // elements are reference counted (AccElementPool) and only copied on write access (writeAccess()), if they are shared.
+  std::shared_ptr<AccMap> elements;
+  std::unique_ptr<AccElementPool,AccElementPool::Disown> pool; // new elements are created here. deleted after its last element
   const Drift* empty_space;
   vector<string> ignoreList;              // elements with a name in this list (can contain 1 wildcard * per entry) are not mounted (set) in this lattice
+  NameMatcher ignoreMatcher;              // compiled ignoreList
   unsigned int ignoreCounter;
   string comment;
 
+  // lazily built indices: built by const member functions, so they can be built by concurrent readers.
+  // indexMutex guards building, validity flags are atomic (checked before and after locking).
+  mutable std::recursive_mutex indexMutex; // recursive: theta index uses type index
+
+  // position index: bucketed grid over circumference, each bucket stores elements.upper_bound(bucket begin)
+  // -> upper_bound(pos) in constant time (on average). built lazily, invalidated by mount/dismount.
+  bool posIndexOn;
+  mutable std::atomic<bool> posIndexValid;
+  mutable double posIndexWidth;
+  mutable std::vector<AccMap::const_iterator> posIndex;
+  void buildPosIndex() const;
+  AccMap::const_iterator upper_bound(double pos) const;  // same as elements.upper_bound(pos), uses position index if enabled
+  const_iterator at(double pos, AccMap::const_iterator ub) const; // at(pos) with given upper_bound(pos)
+  const_iterator find(double pos, AccMap::const_iterator ub) const; // find(pos) with given upper_bound(pos)
+  void invalidateIndices() {posIndexValid=false; typeIndexValid=false; thetaIndexValid=false;} // call after any change of elements map
+
+  // type index: position ordered list of all elements for each element_type, used by type iterators. built lazily.
+  // (map iterators instead of const_iterators, because list is also used by non-const type iterators)
+  mutable std::atomic<bool> typeIndexValid;
+  mutable std::vector<std::vector<AccMap::iterator>> typeIndexLists;
+  const std::vector<AccMap::iterator>& typeIndex(element_type t) const;
+
+  // theta index: begin, end, k0.z and cumulative bending angle up to end of each dipole. built lazily.
+  // invalidated by mount/dismount and by non-const access to any element (k0 can be changed)
+  mutable std::atomic<bool> thetaIndexValid;
+  mutable std::vector<double> thetaBegin, thetaEnd, thetaK0z, thetaSum;
+  void buildThetaIndex() const;
+  double theta(double posIn, unsigned int n) const;  // theta(posIn) with n = number of dipoles with end < posIn
+  void invalidateElementData() const {thetaIndexValid=false;} // call after (possible) change of element data (e.g. strength)
+
+  // copy-on-write
+  static std::shared_ptr<AccMap> newMap(const AccMap &m=AccMap()); // copy of m, elements are retained (released with the map)
+  void detach();                                // own copy of the elements map, if it is shared (call before any non-const map access)
+  AccElement* writeAccess(AccMap::iterator &it, AccMap* &map); // non-const access to element at it (in map, both are moved to own map if needed). Element is copied, if it is used by other lattices
+  void release(AccElement* e) {AccElementPool::release(e);} // element e is not used by this lattice anymore
+  void clearMovedFrom();                        // leave valid empty lattice after move
+
+  // name index: element name -> element. built lazily, updated by mount/dismount.
+  // name can be changed after write access to an element: its entry is removed and the element is pending
+  // until the next lookup, where it is inserted with its current name (no rebuild).
+  mutable std::atomic<bool> nameIndexValid;
+  mutable std::atomic<bool> nameIndexDirty;  // nameIndexPending is not empty
+  mutable std::unordered_multimap<std::string,AccMap::const_iterator> nameIndex;
+  mutable std::set<double> nameIndexPending; // positions of elements without entry in name index
+  void buildNameIndex() const;
+  void updateNameIndex() const;                      // build or insert pending elements
+  void nameIndexInsert(AccMap::const_iterator it);
+  void nameIndexErase(AccMap::const_iterator it);
+  void nameIndexWriteAccess(AccMap::const_iterator it); // element at it can be renamed
+  AccMap::const_iterator findName(const string& name) const; // first element with given name, elements.end() if none
+
   double locate(double pos, const AccElement *obj, Anchor here) const;  // get here=begin/center/end (in meter) of obj at reference-position pos
-  double slope(double pos, const_iterator it) const; // helper function for magnetic field edges (EXPERIMENTAL)
+  AccTriple B(double pos, unsigned int turn, const_iterator it, const AccPair &orbit) const; // B() with it = next magnet with center > pos
+  Spectrum fieldSpectrum(const std::vector<AccPair> &orbit, unsigned int fmax, AccAxis axis, double ampcut, bool edgefields, string name) const; // orbit for each element
   void setCircumference(double c);
 
 
@@ -63,9 +129,11 @@ public:
 
   explicit AccLattice(double _circumference=0., Anchor _refPos=Anchor::end);
   AccLattice(SimToolInstance &sim, Anchor _refPos=Anchor::end, string ignoreFile=""); //direct madx/elegant import
-  AccLattice(const AccLattice &other);
+  AccLattice(const AccLattice &other);                               // elements are shared with other until modification (copy-on-write, constant time)
+  AccLattice(AccLattice &&other);                                    // other is left empty
   ~AccLattice();
-  AccLattice& operator= (const AccLattice &other);
+  AccLattice& operator= (const AccLattice &other);                   // replaces all elements (copy-on-write as copy constructor)
+  AccLattice& operator= (AccLattice &&other);                        // replaces all elements, other is left empty
 
   double circumference() const {return circ;}
   double bentLength() const;                                          // total length of all Dipoles
@@ -76,30 +144,43 @@ public:
   double posMod(double posIn) const {return fmod(posIn,circ);}        // get position modulo circumference
   unsigned int turn(double posIn) const {return int(posIn/circ + ZERO_DISTANCE) + 1;} // get turn from position
   double theta(double posIn) const;                                   // get rotation angle [0,2pi]: increases lin. in bending dipoles, constant in-between.
-
-    // iterator
-    iterator begin() {return iterator(elements.begin(),&elements,&refPos,&circ);}
-    iterator end() {return iterator(elements.end(),&elements,&refPos,&circ);}
+  vector<double> theta(const vector<double> &posIn) const;            // theta() for many positions (fastest for ascending positions)
+  void usePositionIndex(bool on) {posIndexOn=on; invalidateIndices();} // en-/disable position index for at(), find(), behind(), operator[](double) and B() (default: on)
+  void buildIndices() const;                                          // build all lazily built indices now (optional, const access is thread-safe anyway)
+  void modified() {invalidateElementData(); nameIndexValid=false;}   // call after changing elements via pointers kept from it.modify() (see iterator below)
+  RfFactorTable rfFactorTable(unsigned int firstTurn, unsigned int lastTurn) const; // rfFactor() of all RF magnets for given turns (see RfFactorTable)
+
+    // iterator: non-const access to the lattice copies the elements map (not the elements), if it is shared with copies.
+    // it.modify() gives write access (shared element is copied), it.element() and *it are read only.
+    // Changes are detected at write access, so do not keep the pointer from it.modify() for later changes
+    // or call modified() afterwards. It is invalid after mount/dismount/copy-on-write of this element.
+    iterator begin() {detach(); return iterator(elements->begin(),elements.get(),&refPos,&circ,this);}
+    iterator end() {detach(); return iterator(elements->end(),elements.get(),&refPos,&circ,this);}
     iterator begin(element_type t, element_plane p=noplane, element_family f=nofamily);
     template <element_type TYPE, element_plane PLANE=noplane, element_family FAMILY=nofamily>
     type_iterator<TYPE,PLANE,FAMILY> begin() {return type_iterator<TYPE,PLANE,FAMILY>(this->begin(TYPE,PLANE,FAMILY));}
     // const_iterator
-    const_iterator begin() const {return const_iterator(elements.begin(),&elements,&refPos,&circ);}
-    const_iterator end() const {return const_iterator(elements.end(),&elements,&refPos,&circ);}
+    const_iterator begin() const {return const_iterator(elements->begin(),elements.get(),&refPos,&circ,this);}
+    const_iterator end() const {return const_iterator(elements->end(),elements.get(),&refPos,&circ,this);}
     const_iterator begin(element_type t, element_plane p=noplane, element_family f=nofamily) const;
     template <element_type TYPE, element_plane PLANE=noplane, element_family FAMILY=nofamily>
     const_type_iterator<TYPE,PLANE,FAMILY> begin() const {return const_type_iterator<TYPE,PLANE,FAMILY>(this->begin(TYPE,PLANE,FAMILY));}
 
   const AccElement* operator[](double pos) const;  // get element (any position, Drift returned if not inside any element)
   iterator at(double pos);                         // get iterator by position (throws noMatchingElement, if pos is in Drift)
-  iterator behind(double pos, Anchor anchor);      // get iterator to next element with "anchor" behind given position
+  iterator find(double pos);                       // get iterator by position (end(), if pos is in Drift)
+  iterator findBehind(double pos, Anchor anchor);  // get iterator to next element with "anchor" behind given position (end(), if none)
+  iterator behind(double pos, Anchor anchor) {return findBehind(pos,anchor);}
   iterator operator[](string name);                // get iterator by name (first match in lattice, throws noMatchingElement otherwise)
   const_iterator at(double pos) const;
-  const_iterator behind(double pos, Anchor anchor) const;
+  const_iterator find(double pos) const;
+  const_iterator findBehind(double pos, Anchor anchor) const;
+  const_iterator behind(double pos, Anchor anchor) const {return findBehind(pos,anchor);}
   const_iterator operator[](string name) const;
 
   void mount(double pos, const AccElement &obj, bool verbose=false); // mount an element (throws noFreeSpace if no free space for obj)
-  void dismount(double pos);                                         // dismount element at Ref.position pos (if no element at pos: do nothing)
+  void mountBatch(const vector<pair<double,const AccElement*>> &batch, bool verbose=false); // mount many elements (same as mount() for each), lattice unchanged if one does not fit (throws noFreeSpace)
+  void dismount(double pos);                                         // dismount and delete element at Ref.position pos (if no element at pos: do nothing)
   void dismount(iterator it) {dismount(it.pos());}
 
   // import
@@ -116,8 +197,9 @@ public:
   // attention: family of a magnet determines sign of strength export (k1,k2) and calculation of field B()
   // internal variables k1, k2 are not changed.
   void setFamily(const element_family FAMILY, const string& namePattern, const element_type TYPE=drift);
+  void setFamily(const element_family FAMILY, const vector<string>& namePatterns, const element_type TYPE=drift); // all elements matching any pattern
 
-  void subtractCorrectorStrengths(AccLattice &other);    // subtract other corrector strengths from the ones of this lattice
+  void subtractCorrectorStrengths(const AccLattice &other); // subtract other corrector strengths from the ones of this lattice
   void subtractMisalignments(const AccLattice &other);   // subtract other misalignments from the ones of this lattice
 
   // ELSA specific import
@@ -127,7 +209,7 @@ public:
 
   // "information"
   unsigned int size(element_type _type, element_plane p=noplane, element_family f=nofamily) const;        // returns number of elements of a type in this lattice
-  unsigned int size() const {return elements.size();} // returns total number of elements
+  unsigned int size() const {return elements->size();} // returns total number of elements
   string sizeSummary() const; //formated "size" output for all element types
 
   vector<string> getIgnoreList() const {return ignoreList;}
@@ -139,6 +221,19 @@ public:
 
   //EXPERIMENTAL: magnetic field, including continuous slope at start/end
   AccTriple B(double pos, const AccPair &orbit) const;
+  AccTriple B(const LatticeCursor &cursor, const AccPair &orbit) const; // B() at cursor position (fast for increasing positions, see LatticeCursor)
+  void B(const double *posIn, const double *x, const double *z, unsigned int n, AccTriple *out,
+	 const RfFactorTable *rf=nullptr) const; // out[i] = B(posIn[i], orbit (x[i],z[i])), batch per element (fast for increasing positions)
+  double slope(double pos, const_iterator it) const;                      // edge field factor of element it at pos (used by B())
+  static double edgeSlope(double distBegin, double distEnd, double halfDl, double sigma); // slope() from distanceRing() to begin & end of element
+  static double ringDistance(double d, double circ);                         // distance d (pos - element) in ring: shorter of both directions
+  static double gaussSlope(double u);                                       // exp(-0.5*u^2), tabulated with max. error EDGEFIELD_SLOPE_TOLERANCE (config.hpp)
+
+  // analytic Fourier series of the field B() of one turn (no sampling, no FFT), same conventions as Field::getSpectrum().
+  // each magnet contributes its field at orbit(center) with hard edges or with Gaussian edge fields (edgefields=true).
+  // RF magnets are included with rfFactor(1).
+  Spectrum fieldSpectrum(FunctionOfPos<AccPair> &orbit, unsigned int fmax=30, AccAxis axis=x, double ampcut=0., bool edgefields=true, string name="") const;
+  Spectrum fieldSpectrum(unsigned int fmax=30, AccAxis axis=x, double ampcut=0., bool edgefields=true, string name="") const; // without orbit
 
 
   //additional Physical Quantities
@@ -168,8 +263,13 @@ public:
       double value;
       paramRow() : name(""), type(""), param(""), value(0.) {};
     };
+    // elements created during import (in pool of this lattice), released if not mounted
+    typedef std::unique_ptr<AccElement,AccElementPool::Release> ElementPtr;
+    typedef vector<pair<double,ElementPtr>> ImportBatch;
     iterator cast_helper(const const_iterator& it);
-    void elegantimport_mount(const double& s, paramRow& row_old, const paramMap& params, const double& l);
+    void mountBatch_helper(const vector<pair<double,const AccElement*>> &batch, bool verbose, bool adopt); // adopt: mount elements of batch (in own pool) without copy
+    void elegantimport_mount(const double& s, paramRow& row_old, const paramMap& params, const double& l, ImportBatch &batch);
+    void mountImported(const ImportBatch &batch); // mountBatch() without copy of the elements
     void resetParams(paramMap &params);
 
     
@@ -191,7 +291,33 @@ public:
 
 
 
-  
+
+
+// cursor for sweeps through a lattice with increasing positions (e.g. field sampling):
+// stores the next element with center behind the current position and advances it
+// element by element -> amortized constant time per position.
+// Moving backwards (or to the next turn) is possible, but needs a lookup (AccLattice::findBehind()).
+// The cursor is invalid after mounting/dismounting elements in the lattice.
+class LatticeCursor {
+protected:
+  const AccLattice* lattice;
+  AccLattice::const_iterator nextIt; // next element with center > pos
+  double posIn;                      // position including turns
+  double pos;                        // position in turn (posMod(posIn))
+  unsigned int t;                    // turn
+
+public:
+  explicit LatticeCursor(const AccLattice &l);
+
+  void moveTo(double posIn);  // set position (including turns). increasing positions are fast.
+  double position() const {return posIn;}
+  double posInTurn() const {return pos;}
+  unsigned int turn() const {return t;}
+  const AccLattice::const_iterator& next() const {return nextIt;} // next element with center behind position
+};
+
+
+
 string removeQuote(string s); //remove quotation marks ("" or '') from begin&end of string
 
 
@@ -0,0 +1,185 @@
+/* CompiledLattice Class
+ * Immutable snapshot of an AccLattice with all element data stored in contiguous arrays
+ * ("structure of arrays"). Intended for hot loops (e.g. field sampling over many turns),
+ * where lookups in the AccLattice map and virtual calls of the elements dominate.
+ *
+ * Copyright (C) 2016 Jan Felix Schmidt <janschmidt@mailbox.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include "CompiledLattice.hpp"
+
+using namespace pal;
+
+const unsigned int CompiledLattice::npos = std::numeric_limits<unsigned int>::max();
+
+
+CompiledLattice::CompiledLattice(const AccLattice &lattice)
+  : circ(lattice.circumference()), refPos(lattice.refPos)
+{
+  unsigned int n = lattice.size();
+  _pos.reserve(n); _begin.reserve(n); _center.reserve(n); _end.reserve(n);
+  _type.reserve(n); _family.reserve(n); _name.reserve(n); _field.reserve(n);
+  k0x.reserve(n); k0z.reserve(n); k0s.reserve(n); _k1.reserve(n); _k2.reserve(n);
+  _tilt.reserve(n); dx.reserve(n); dz.reserve(n); halfDl.reserve(n); sigma.reserve(n);
+  Qrf1.reserve(n); dQrf.reserve(n); rfPeriod.reserve(n);
+
+  for (auto it=lattice.begin(); it!=lattice.end(); ++it) {
+    const AccElement* e = it.element();
+    _pos.push_back(it.pos());
+    _begin.push_back(it.begin());
+    _center.push_back(it.center());
+    _end.push_back(it.end());
+    _type.push_back(e->type);
+    _family.push_back(e->family);
+    _name.push_back(e->name);
+    _field.push_back(e->field());
+    k0x.push_back(e->k0.x);
+    k0z.push_back(e->k0.z);
+    k0s.push_back(e->k0.s);
+    _k1.push_back(e->k1);
+    _k2.push_back(e->k2);
+    _tilt.push_back(e->tilt);
+    dx.push_back(e->displacement.x);
+    dz.push_back(e->displacement.z);
+    halfDl.push_back(e->edgeHalfDl());
+    sigma.push_back(e->edgeSigma());
+    Qrf1.push_back(e->Qrf1);
+    dQrf.push_back(e->dQrf);
+    rfPeriod.push_back(e->rfPeriod);
+  }
+}
+
+
+
+double CompiledLattice::pos(unsigned int i, Anchor anchor) const
+{
+  switch(anchor) {
+  case Anchor::begin:
+    return _begin[i];
+  case Anchor::center:
+    return _center[i];
+  case Anchor::end:
+    return _end[i];
+  }
+  return 0.;
+}
+
+AccTriple CompiledLattice::k0(unsigned int i) const
+{
+  AccTriple tmp;
+  tmp.x = k0x[i];
+  tmp.z = k0z[i];
+  tmp.s = k0s[i];
+  return tmp;
+}
+
+AccPair CompiledLattice::displacement(unsigned int i) const
+{
+  AccPair tmp;
+  tmp.x = dx[i];
+  tmp.z = dz[i];
+  return tmp;
+}
+
+
+
+unsigned int CompiledLattice::upper_bound(double pos) const
+{
+  return std::upper_bound(_pos.begin(), _pos.end(), pos) - _pos.begin();
+}
+
+// get index by position, npos if pos is in Drift
+// (see AccLattice::at() for the candidates)
+unsigned int CompiledLattice::find(double pos) const
+{
+  unsigned int i = upper_bound(pos);
+  if (i<size() && pos>=_begin[i] && pos<=_end[i])
+    return i;
+  if (i>0) {
+    --i;
+    if (pos>=_begin[i] && pos<=_end[i])
+      return i;
+  }
+  return npos;
+}
+
+// get index by position, throws noMatchingElement if pos is in Drift
+unsigned int CompiledLattice::at(double pos) const
+{
+  unsigned int i = find(pos);
+  if (i != npos)
+    return i;
+
+  std::stringstream s;
+  s << "no element at " << pos << " m";
+  throw AccLattice::noMatchingElement(s.str());
+}
+
+unsigned int CompiledLattice::operator[](double pos) const
+{
+  if (pos > circumference()) {
+    stringstream msg;
+    msg << pos << " m is larger than lattice circumference " << circumference() << " m.";
+    throw palatticeError(msg.str());
+  }
+  return find(pos);
+}
+
+// get index of next element with "anchor" behind given position
+unsigned int CompiledLattice::behind(double pos, Anchor anchor) const
+{
+  unsigned int i = find(pos);
+  if (i == npos)
+    i = upper_bound(pos);
+  else if (this->pos(i,anchor) <= pos)
+    ++i;
+  if (i >= size())
+    return npos;
+  return i;
+}
+
+
+
+double CompiledLattice::slope(double pos, unsigned int i) const
+{
+  return AccLattice::edgeSlope(distanceRing(i,Anchor::begin,pos), distanceRing(i,Anchor::end,pos), halfDl[i], sigma[i]);
+}
+
+
+
+// magnetic field including edge fields, see AccLattice::B()
+AccTriple CompiledLattice::B(double posIn, const AccPair &orbit) const
+{
+  double pos = posMod(posIn);
+  unsigned int t = turn(posIn);
+  // next magnet with center > pos:
+  unsigned int i = behind(pos,Anchor::center);
+  if (i == npos)
+    throw palatticeError("Evaluation of lattice.end(), which is after last Element!");
+  AccTriple field;
+  if (hasField(i))
+    field = B_rf(i,t,orbit) * slope(pos,i);
+  // previous magnet (center <= pos):
+  if (i == 0) i = size();
+  --i;
+  if (hasField(i))
+    field += B_rf(i,t,orbit) * slope(pos,i);
+
+  return field;
+}
@@ -0,0 +1,112 @@
+/* CompiledLattice Class
+ * Immutable snapshot of an AccLattice with all element data stored in contiguous arrays
+ * ("structure of arrays"). Intended for hot loops (e.g. field sampling over many turns),
+ * where lookups in the AccLattice map and virtual calls of the elements dominate.
+ *
+ * Copyright (C) 2016 Jan Felix Schmidt <janschmidt@mailbox.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Elements are accessed by index i, which corresponds to the i-th element of the AccLattice
+ * (ordered by position). Lookup functions return npos instead of AccLattice::end().
+ * The snapshot does not reference the AccLattice it was built from, so later changes
+ * of the lattice are NOT reflected. Build a new CompiledLattice after modifications.
+ *
+ * Standalone API for user loops: the library itself (e.g. Field::set()) evaluates AccLattice directly.
+ * Field calculation uses the same kernels as AccLattice::B() (ElementField, AccLattice::edgeSlope(),
+ * AccElement::rfFactor()), so results are identical.
+ */
+
+#ifndef __LIBPALATTICE_COMPILEDLATTICE_HPP_
+#define __LIBPALATTICE_COMPILEDLATTICE_HPP_
+
+#include <vector>
+#include <string>
+#include "AccLattice.hpp"
+
+namespace pal
+{
+
+  class CompiledLattice {
+  protected:
+    double circ;
+    Anchor refPos;
+
+    // one entry per element, ordered by position
+    std::vector<double> _pos;            // reference position (refPos) / m
+    std::vector<double> _begin;          // begin / m
+    std::vector<double> _center;         // center / m
+    std::vector<double> _end;            // end / m
+    std::vector<element_type> _type;
+    std::vector<element_family> _family;
+    std::vector<std::string> _name;
+    std::vector<ElementField> _field;    // field parameters (zero for elements without field)
+    std::vector<double> k0x, k0z, k0s;
+    std::vector<double> _k1, _k2;
+    std::vector<double> _tilt;
+    std::vector<double> dx, dz;          // displacement / m
+    std::vector<double> halfDl;          // dl()/2, edge field length at each magnet end / m
+    std::vector<double> sigma;           // sigma of Gaussian edge field slope / m
+    std::vector<double> Qrf1, dQrf;
+    std::vector<unsigned int> rfPeriod;
+
+    double distanceRing(unsigned int i, Anchor anchor, double pos) const {return AccLattice::ringDistance(pos - this->pos(i,anchor), circ);} // same as AccLattice::const_iterator::distanceRing()
+    double slope(double pos, unsigned int i) const;                       // same as AccLattice::slope()
+    unsigned int upper_bound(double pos) const;                           // index of first element with reference position > pos
+
+  public:
+    static const unsigned int npos;  // "no element", corresponds to AccLattice::end()
+
+    explicit CompiledLattice(const AccLattice &lattice);
+
+    unsigned int size() const {return _pos.size();}
+    double circumference() const {return circ;}
+    Anchor getRefPos() const {return refPos;}
+    double posMod(double posIn) const {return fmod(posIn,circ);}
+    unsigned int turn(double posIn) const {return int(posIn/circ + ZERO_DISTANCE) + 1;}
+
+    // element data by index
+    double pos(unsigned int i) const {return _pos[i];}
+    double pos(unsigned int i, Anchor anchor) const;
+    double begin(unsigned int i) const {return _begin[i];}
+    double center(unsigned int i) const {return _center[i];}
+    double end(unsigned int i) const {return _end[i];}
+    element_type type(unsigned int i) const {return _type[i];}
+    element_family family(unsigned int i) const {return _family[i];}
+    const std::string& name(unsigned int i) const {return _name[i];}
+    AccTriple k0(unsigned int i) const;
+    double k1(unsigned int i) const {return _k1[i];}
+    double k2(unsigned int i) const {return _k2[i];}
+    double tilt(unsigned int i) const {return _tilt[i];}
+    AccPair displacement(unsigned int i) const;
+
+    // lookup by position, same behavior as the AccLattice functions
+    unsigned int operator[](double pos) const;               // index of element at pos (npos if pos is in Drift)
+    unsigned int at(double pos) const;                       // index of element at pos (throws AccLattice::noMatchingElement, if pos is in Drift)
+    unsigned int find(double pos) const;                     // index of element at pos (npos if pos is in Drift), same as operator[] without circumference check
+    unsigned int behind(double pos, Anchor anchor) const;    // index of next element with "anchor" behind given position (npos if none)
+
+    // magnetic field
+    bool hasField(unsigned int i) const {return !_field[i].zero;}
+    AccTriple B(unsigned int i, const AccPair &orbit) const {return _field[i].B(orbit);} // field of element i, same as AccElement::B(orbit)
+    double rfFactor(unsigned int i, unsigned int turn) const {return AccElement::rfFactor(turn, Qrf1[i], dQrf[i], rfPeriod[i]);}
+    AccTriple B_rf(unsigned int i, unsigned int turn, const AccPair &orbit) const {return B(i,orbit) * rfFactor(i,turn);}
+    AccTriple B(double pos, const AccPair &orbit) const;     // same as AccLattice::B(), including edge fields
+  };
+
+} //namespace pal
+
+#endif
+/*__LIBPALATTICE_COMPILEDLATTICE_HPP_*/
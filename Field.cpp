@@ -24,63 +24,610 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <thread>
+#include <exception>
+#include <algorithm>
+#include <complex>
 #include "Field.hpp"
 
 using namespace pal;
 
 
 // set all magnetic field values from lattice and orbit
-void Field::set(AccLattice &lattice, FunctionOfPos<AccPair>& orbit, unsigned int n_samples, bool edgefields)
+void Field::set(AccLattice &lattice, FunctionOfPos<AccPair>& orbit, unsigned int n_samples, bool edgefields, unsigned int n_threads)
 {
   //metadata
   stringstream stmp;
   stmp << n_samples << " points per turn";
   this->info.add("Field sampling", stmp.str());
+
+  double interval_samp = this->circ / n_samples; // sampling interval of magn. field values along ring in meter
+  samplePos.resize(n_samples);
+  for (unsigned int i=0; i<n_samples; i++)
+    samplePos[i] = i*interval_samp;
+  adaptive = false;
+  setType(uniformType);
+
+  setAll(lattice, orbit, edgefields, n_threads);
+}
+
+
+// set field values at samplePos in all turns of orbit
+// samples are split into n_threads blocks, which are calculated in parallel.
+// results are the same as for serial calculation.
+void Field::setAll(AccLattice &lattice, FunctionOfPos<AccPair>& orbit, bool edgefields, unsigned int n_threads)
+{
   this->info += lattice.info;
   this->info += orbit.info;
 
-  unsigned int i, t;
+  bool noorbit = checkOrbit(orbit, "set");
+  unsigned int n_samples = samplePos.size();
+  unsigned int n_total = orbit.turns() * n_samples;
+  lastEdgefields = edgefields;
+
+  // threads
+  if (n_threads == 0) // automatic
+    n_threads = std::min(std::thread::hardware_concurrency(), n_total/FIELD_SET_MIN_SAMPLES_PER_THREAD);
+  n_threads = std::max(1u, std::min(n_threads, n_total));
+
+  // lattice is accessed const only. build its indices now, so that threads do not modify it.
+  const AccLattice &cLattice = lattice;
+  cLattice.buildIndices();
+  const RfFactorTable rf = cLattice.rfFactorTable(1, orbit.turns());
+
+  std::vector<AccTriple> B(n_total);
+  const FunctionOfPos<AccPair> &cOrbit = orbit; // initialized by checkOrbit(), const interpolation is thread-safe
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(n_threads);
+  for (unsigned int n=1; n<n_threads; n++) {
+    threads.push_back(std::thread([&,n]() {
+	  try {
+	    setSamples(cLattice, cOrbit, rf, noorbit, edgefields, n_total*n/n_threads, n_total*(n+1)/n_threads, &B[n_total*n/n_threads]);
+	  }
+	  catch (...) {
+	    errors[n] = std::current_exception();
+	  }
+	}));
+  }
+  try {
+    setSamples(cLattice, cOrbit, rf, noorbit, edgefields, 0, n_total/n_threads, B.data());
+  }
+  catch (...) {
+    errors[0] = std::current_exception();
+  }
+  for (auto &thread : threads)
+    thread.join();
+  for (auto &e : errors) {
+    if (e)
+      std::rethrow_exception(e);
+  }
+
+  // replace all data: samples of a previous set() or setAdaptive() at other positions would remain otherwise
+  this->clear();
+  Batch batch(*this);
+  reserve(n_total);
+  for (unsigned int k=0; k<n_total; k++)
+    this->FunctionOfPos<AccTriple>::set(B[k], samplePos[k%n_samples], k/n_samples+1);
+}
+
+
+// adaptive sampling, see Field.hpp
+void Field::setAdaptive(AccLattice &lattice, FunctionOfPos<AccPair>& orbit, double accuracy, double maxInterval, bool edgefields, unsigned int n_threads)
+{
+  if (accuracy <= 0. || accuracy >= 1. || maxInterval <= 0.) {
+    stringstream msg;
+    msg << "ERROR: Field::setAdaptive(): invalid accuracy " << accuracy << " (0 < accuracy < 1) or max. interval " << maxInterval << " m.";
+    throw palatticeError(msg.str());
+  }
+  samplePos = adaptivePositions(lattice, accuracy, maxInterval, edgefields);
+  adaptive = true;
+  setType(gsl_interp_linear); // sample intervals are chosen for linear interpolation
+
+  //metadata
+  stringstream stmp;
+  stmp << "adaptive, " << samplePos.size() << " points per turn (accuracy " << accuracy << ", max. interval " << maxInterval << " m)";
+  this->info.add("Field sampling", stmp.str());
+
+  setAll(lattice, orbit, edgefields, n_threads);
+}
+
+// sample positions in one turn:
+// - every maxInterval (field changes with orbit only)
+// - Gaussian edge fields: from edge up to the distance where slope < accuracy with interval sigma*sqrt(8*accuracy)
+//   (linear interpolation error < interval^2/8 * max|slope''| = interval^2/8 / sigma^2)
+// - hard edges (edgefields=false or dl=0): at begin/end and ZERO_DISTANCE outside
+std::vector<double> Field::adaptivePositions(const AccLattice &lattice, double accuracy, double maxInterval, bool edgefields) const
+{
+  std::vector<double> pos;
+  for (unsigned int i=0; i*maxInterval < circ; i++)
+    pos.push_back(i*maxInterval);
+
+  for (AccLattice::const_iterator it=lattice.begin(); it!=lattice.end(); ++it) {
+    const AccElement *e = it.element();
+    if (!e->hasField())
+      continue;
+    double begin = it.begin();
+    double end = begin + e->length;
+    double sigma = e->edgeSigma();
+    if (edgefields && sigma > 0.) {
+      double h = e->edgeHalfDl();
+      double width = sigma * sqrt(-2.*log(accuracy));
+      double step = sigma * sqrt(8.*accuracy);
+      for (double x=0.; x<width+step; x+=step) {
+	pos.push_back(begin + h - x);
+	pos.push_back(end - h + x);
+      }
+    }
+    else {
+      for (double p : {begin-ZERO_DISTANCE, begin, end, end+ZERO_DISTANCE})
+	pos.push_back(p);
+    }
+  }
+
+  for (double &p : pos) {
+    p = fmod(p, circ);
+    if (p < 0.) p += circ;
+  }
+  std::sort(pos.begin(), pos.end());
+  std::vector<double> out;
+  for (double p : pos) {
+    if (out.empty() || p - out.back() > 0.1*ZERO_DISTANCE)
+      out.push_back(p);
+  }
+  return out;
+}
+
+
+// replace data by n_samples equidistant points per turn, e.g. for FFT of adaptive samples.
+// values are interpolated, after the last sample the last value is used.
+void Field::resample(unsigned int n_samples)
+{
+  if (size() == 0)
+    return;
+
+  unsigned int n_turns = turns();
+  double interval_samp = this->circ / n_samples;
+  std::vector<AccTriple> B(n_turns*n_samples);
+  for (unsigned int k=0; k<B.size(); k++) {
+    double pos = posTotal((k%n_samples)*interval_samp, k/n_samples+1);
+    if (pos < interpMin())
+      B[k] = data.begin()->second;
+    else if (pos > interpMax())
+      B[k] = data.rbegin()->second;
+    else
+      B[k] = interp(pos);
+  }
+
+  this->clear();
+  samplePos.resize(n_samples);
+  for (unsigned int i=0; i<n_samples; i++)
+    samplePos[i] = i*interval_samp;
+  adaptive = false;
+  setType(uniformType);
+  Batch batch(*this);
+  reserve(B.size());
+  for (unsigned int k=0; k<B.size(); k++)
+    this->FunctionOfPos<AccTriple>::set(B[k], samplePos[k%n_samples], k/n_samples+1);
+  stringstream stmp;
+  stmp << n_samples << " points per turn (resampled)";
+  this->info.add("Field sampling", stmp.str());
+}
+
+
+// spectrum of the linear interpolation of non-equidistant (adaptive) samples, periodic over all turns (length L).
+// f is piecewise linear, so f'' = sum of slope changes ds_m at samples x_m and the Fourier coefficients are exactly
+//   c(w) = 1/L integral f(x) exp(-i w x) dx = -1/(L w^2) sum_m ds_m exp(-i w x_m)    (w = 2 pi k / L)
+// The dense samples at the magnet edges are used, in contrast to resample() and FFT.
+// normalization and phase convention are the same as for Spectrum::fft()
+Spectrum Field::adaptiveSpectrum(AccAxis axis, unsigned int fmaxrev, double ampcut, string name) const
+{
+  typedef std::complex<double> cplx;
+  if (name=="") name = axis_string(axis);
+  Spectrum spec(name, fmaxrev, ampcut);
+  spec.setLength(circ, meter, turns());
+  unsigned int n = size();
+  if (n == 0)
+    return spec;
+
+  double L = circ * turns();
+  const std::vector<double> &x = data.keys();
+  std::vector<double> f(n);
+  for (unsigned int m=0; m<n; m++) {
+    const AccTriple &b = data.values()[m];
+    f[m] = (axis==pal::x) ? b.x : ((axis==pal::z) ? b.z : b.s);
+  }
+  auto next = [&](unsigned int m) {return (m+1<n) ? m+1 : 0;};
+  auto interval = [&](unsigned int m) {return (m+1<n) ? x[m+1]-x[m] : x[0]+L-x[m];}; // last interval: periodic
+  std::vector<double> slope(n);
+  double c0 = 0.;
+  for (unsigned int m=0; m<n; m++) {
+    double dx = interval(m);
+    slope[m] = (dx > 0.) ? (f[next(m)]-f[m]) / dx : 0.;
+    c0 += 0.5*(f[m]+f[next(m)]) * dx;
+  }
+
+  FREQCOMP comp;
+  comp.amp = std::abs(c0/L);
+  spec.push_back(comp);
+  for (unsigned int k=1; k<=fmaxrev*turns(); k++) {
+    double w = 2*M_PI*k/L;
+    cplx c;
+    for (unsigned int m=0; m<n; m++)
+      c += (slope[m] - slope[(m>0) ? m-1 : n-1]) * std::polar(1., -w*x[m]);
+    c *= -1./(L*w*w);
+    comp.freq = k*spec.dFreq();
+    comp.amp = 2*std::abs(c);
+    comp.phase = std::arg(c);
+    if (comp.amp < MIN_AMPLITUDE)
+      comp.phase = 0.;
+    else if (comp.phase < 0.)
+      comp.phase += 2*M_PI;
+    spec.push_back(comp);
+  }
+  spec.info.add("Spectrum calculation", "linear interpolation of adaptive samples");
+  for (unsigned int i=2; i<this->info.size(); i++)
+    spec.info.add(this->info.getLabel(i), this->info.getEntry(i));
+  return spec;
+}
+
+
+// check orbit once (instead of catching exceptions of orbit.interp() for each sample)
+// only samples in ranges (in all turns) are checked for extrapolation, empty ranges: all samples
+bool Field::checkOrbit(FunctionOfPos<AccPair> &orbit, string caller, const SampleRanges &ranges) const
+{
+  if (this->circ != orbit.circumference()) {
+    stringstream msg;
+    msg << "ERROR: Field::" << caller << "(): Field and orbit have different circumferences ("
+	 <<this->circ <<", "<<orbit.circumference()<<").";
+    throw palatticeError(msg.str());
+  }
+
+  if (orbit.size() < 2) { //no orbit available: use field without orbit
+    cout << "WARNING: Field::" << caller << "(): Interpolation of orbit not possible for only " << orbit.size()
+	 << " datapoints. Field is calculated without orbit." << endl;
+    return true;
+  }
+  if (!orbit.initialized())
+    orbit.init();
+
+  SampleRanges all(1, std::make_pair(0u, (unsigned int)samplePos.size()));
+  const SampleRanges &r = ranges.empty() ? all : ranges;
+  for (unsigned int t=1; t<=orbit.turns(); t++) {
+    for (auto &range : r) {
+      for (unsigned int i=range.first; i<range.second; i++) {
+	double pos = orbit.posTotal(samplePos[i], t);
+	if (pos < orbit.interpMin() || pos > orbit.interpMax()) {
+	  cout << "WARNING: Field::" << caller << "(): No orbit at " << pos << " m (extrapolation). Use orbit of previous sample." << endl;
+	  return false;
+	}
+      }
+    }
+  }
+  return false;
+}
+
+
+void Field::setSamples(const AccLattice &lattice, const FunctionOfPos<AccPair> &orbit, const RfFactorTable &rf, bool noorbit, bool edgefields,
+		       unsigned int first, unsigned int last, AccTriple *B) const
+{
+  unsigned int t;
   double _pos, _pos_tot;
-  stringstream msg;
   AccPair otmp;
-  AccTriple Btmp;
+  InterpAccel acc; // own accelerator for each thread
+  unsigned int n_samples = samplePos.size();
+  auto posTotal = [&](unsigned int k) {return orbit.posTotal(samplePos[k%n_samples], k/n_samples+1);};
+  auto orbitAvailable = [&](double pos) {return (pos >= orbit.interpMin() && pos <= orbit.interpMax());};
+
+  // if there is no orbit at the first sample, the orbit of the last previous sample with orbit is used
+  if (!noorbit) {
+    for (unsigned int k=first; k>0; k--) {
+      if (orbitAvailable(posTotal(k-1))) {
+	otmp = orbit.interp(posTotal(k-1), acc);
+	break;
+      }
+    }
+  }
+
+  // positions and orbit of all samples, field is calculated in batches per element
+  unsigned int n = last - first;
+  std::vector<double> posTot(n), x(n), z(n);
+  for (unsigned int k=first; k<last; k++) {
+    t = k/n_samples + 1;
+    _pos = samplePos[k%n_samples];
+    _pos_tot = orbit.posTotal(_pos, t);
+    if (!noorbit && orbitAvailable(_pos_tot))
+      otmp = orbit.interp(_pos_tot, acc);
+    posTot[k-first] = _pos_tot;
+    x[k-first] = otmp.x;
+    z[k-first] = otmp.z;
+  }
+
+  if (edgefields) {
+    lattice.B(posTot.data(), x.data(), z.data(), n, B, &rf); // sample positions are increasing in each turn
+    return;
+  }
+
+  // without edgefields: consecutive samples in the same element and turn
+  unsigned int k = first;
+  while (k < last) {
+    t = k/n_samples + 1;
+    const AccElement *e = lattice[samplePos[k%n_samples]];
+    unsigned int m = 1;
+    while (k+m < last && (k+m)/n_samples+1 == t && lattice[samplePos[(k+m)%n_samples]] == e)
+      m++;
+    e->B(&x[k-first], &z[k-first], m, &B[k-first]);
+    double factor = rf(e,t);
+    for (unsigned int j=k; j<k+m; j++)
+      B[j-first] *= factor;
+    k += m;
+  }
+}
+
+
+
+// recalculate samples influenced by element changed in all turns.
+// with edgefields an element influences B() between the centers of its neighbours (see AccLattice::B()),
+// otherwise only inside the element. The sample range is extended by one sample at each side,
+// additional samples get the same values as by set().
+void Field::update(AccLattice &lattice, FunctionOfPos<AccPair> &orbit, AccLattice::const_iterator changed)
+{
+  if (samplePos.empty())
+    throw palatticeError("Field::update(): no field to update. Use set() first.");
+  if (changed == lattice.end())
+    throw palatticeError("Field::update(): changed element is lattice.end()");
+  if (orbit.turns() != turns()) {
+    stringstream msg;
+    msg << "Field::update(): orbit has " << orbit.turns() << " turns, but field was set for " << turns() << " turns.";
+    throw palatticeError(msg.str());
+  }
+
+  const AccLattice &cLattice = lattice;
+  unsigned int n_samples = samplePos.size();
+
+  // range of positions influenced by changed
+  double from, to;
+  if (lastEdgefields) {
+    AccLattice::const_iterator prev = changed, next = changed;
+    if (prev == cLattice.begin()) {
+      prev = cLattice.end();
+      --prev;
+      from = prev.center() - circ;
+    }
+    else
+      from = (--prev).center();
+    ++next;
+    if (next == cLattice.end())
+      to = cLattice.begin().center() + circ;
+    else
+      to = next.center();
+  }
+  else {
+    from = changed.begin();
+    to = changed.end();
+    if (to < from) // element at end and begin of ring
+      to += circ;
+  }
+
+  // sample ranges [first,last) in one turn
+  auto lower = [&](double pos) -> unsigned int {
+    unsigned int i = std::lower_bound(samplePos.begin(), samplePos.end(), pos) - samplePos.begin();
+    return (i>0) ? i-1 : 0;
+  };
+  auto upper = [&](double pos) -> unsigned int {
+    unsigned int i = std::upper_bound(samplePos.begin(), samplePos.end(), pos) - samplePos.begin();
+    return std::min(i+1, n_samples);
+  };
+  SampleRanges ranges;
+  if (to - from >= circ)
+    ranges.push_back(std::make_pair(0u, n_samples));
+  else if (from < 0.) {
+    ranges.push_back(std::make_pair(lower(from+circ), n_samples));
+    ranges.push_back(std::make_pair(0u, upper(to)));
+  }
+  else if (to >= circ) {
+    ranges.push_back(std::make_pair(lower(from), n_samples));
+    ranges.push_back(std::make_pair(0u, upper(to-circ)));
+  }
+  else
+    ranges.push_back(std::make_pair(lower(from), upper(to)));
+
+  bool noorbit = checkOrbit(orbit, "update", ranges);
+  const RfFactorTable rf = cLattice.rfFactorTable(1, turns());
+
+  std::vector<AccTriple> B;
+  for (unsigned int t=1; t<=turns(); t++) {
+    unsigned int k0 = (t-1)*n_samples;
+    for (auto &r : ranges) {
+      if (r.second <= r.first)
+	continue;
+      B.resize(r.second - r.first);
+      setSamples(cLattice, orbit, rf, noorbit, lastEdgefields, k0+r.first, k0+r.second, B.data());
+      for (unsigned int i=r.first; i<r.second; i++)
+	this->FunctionOfPos<AccTriple>::set(B[i-r.first], samplePos[i], t);
+    }
+  }
+}
+
+Spectrum Field::getSpectrum(AccAxis axis, unsigned int fmaxrev, double ampcut, string name) const
+{
+  if (adaptive) // FFT needs equidistant data
+    return adaptiveSpectrum(axis,fmaxrev,ampcut,name);
+  return FunctionOfPos<AccTriple>::getSpectrum(0,axis,fmaxrev,ampcut,name);
+}
+
+
+
+// set field of 1 turn separated in static field and RF magnet fields (see Field.hpp).
+// orbit is evaluated in turn 1 for all turns.
+// B() gives the same values as Field::set() with this orbit repeated in each turn
+// (except for rounding of sample positions in turns > 1, which Field::set() calculates via posTotal()).
+void SeparableField::set(AccLattice &lattice, FunctionOfPos<AccPair>& orbit, unsigned int n_samples, unsigned int n_turns_in, bool edgefields)
+{
+  if (circ != orbit.circumference()) {
+    stringstream msg;
+    msg << "ERROR: SeparableField::set(): Field and orbit have different circumferences ("
+	 <<circ <<", "<<orbit.circumference()<<").";
+    throw palatticeError(msg.str());
+  }
+  if (n_turns_in == 0)
+    throw palatticeError("ERROR: SeparableField::set(): number of turns must be > 0.");
+
+  data.clear();
+  factor.clear();
+  n_turns = n_turns_in;
+  lastEdgefields = edgefields;
+
+  //metadata
+  stringstream stmp;
+  stmp << n_samples << " points per turn";
+  info.add("Field sampling", stmp.str());
+  stmp.str(std::string());
+  stmp << n_turns_in << " turns, separable (static & RF magnets)";
+  info.add("Field turns", stmp.str());
+  info += lattice.info;
+  info += orbit.info;
+
   bool noorbit = false;
+  if (orbit.size() < 2) {
+    cout << "WARNING: SeparableField::set(): Interpolation of orbit not possible for only " << orbit.size()
+	 << " datapoints. Field is calculated without orbit." << endl;
+    noorbit = true;
+  }
+  else if (!orbit.initialized())
+    orbit.init();
+
+  const AccLattice &cLattice = lattice;
+  double interval_samp = circ / n_samples;
+  std::unordered_map<const AccElement*,unsigned int> rfIndex;
+  LatticeCursor cursor(cLattice);
+  AccPair otmp;
+  bool warned = false;
+  data.assign(n_samples, Sample());
 
- double interval_samp = this->circ / n_samples; // sampling interval of magn. field values along ring in meter
+  for (unsigned int i=0; i<n_samples; i++) {
+    double _pos = i*interval_samp;
+    if (!noorbit) {
+      if (_pos >= orbit.interpMin() && _pos <= orbit.interpMax())
+	otmp = orbit.interp(_pos);
+      else if (!warned) {
+	cout << "WARNING: SeparableField::set(): No orbit at " << _pos << " m (extrapolation). Use orbit of previous sample." << endl;
+	warned = true;
+      }
+    }
 
-  if (this->circ != orbit.circumference()) {
-    msg << "ERROR: Field::set(): Field and orbit have different circumferences ("
-	 <<this->circ <<", "<<orbit.circumference()<<").";
+    // same elements as AccLattice::B() resp. Field::set() without edgefields
+    if (edgefields) {
+      cursor.moveTo(_pos);
+      AccLattice::const_iterator it = cursor.next();
+      if (it == cLattice.end())
+	throw palatticeError("Evaluation of lattice.end(), which is after last Element!");
+      add(data[i], it.element(), cLattice.slope(_pos,it), otmp, rfIndex);
+      if (it == cLattice.begin()) it = cLattice.end();
+      --it;
+      add(data[i], it.element(), cLattice.slope(_pos,it), otmp, rfIndex);
+    }
+    else
+      add(data[i], cLattice[_pos], 1., otmp, rfIndex);
+  }
+}
+
+void SeparableField::add(Sample &sample, const AccElement *e, double slope, const AccPair &orbit,
+			 std::unordered_map<const AccElement*,unsigned int> &rfIndex)
+{
+  if (!e->isRF()) {
+    AccTriple b = e->B_rf(1,orbit) * slope;
+    if (sample.hasStatic)
+      sample.Bstatic += b;
+    else
+      sample.Bstatic = b;
+    sample.hasStatic = true;
+    return;
+  }
+
+  auto rf = rfIndex.find(e);
+  if (rf == rfIndex.end()) {
+    std::vector<double> f(n_turns);
+    for (unsigned int t=1; t<=n_turns; t++)
+      f[t-1] = e->rfFactor(t);
+    factor.push_back(std::move(f));
+    rf = rfIndex.insert(std::make_pair(e, factor.size()-1)).first;
+  }
+  sample.rf[sample.nRF] = rf->second;
+  sample.Brf[sample.nRF] = e->B(orbit);
+  sample.slope[sample.nRF] = slope;
+  sample.nRF++;
+}
+
+
+AccTriple SeparableField::B(unsigned int sample, unsigned int turn) const
+{
+  if (sample >= data.size() || turn < 1 || turn > n_turns) {
+    stringstream msg;
+    msg << "SeparableField::B(): no sample " << sample << " in turn " << turn
+	<< " (" << data.size() << " samples, " << n_turns << " turns).";
     throw palatticeError(msg.str());
   }
 
-   for (t=1; t<=orbit.turns(); t++) {
-     for (i=0; i<n_samples; i++) {
-       _pos = i*interval_samp;
-       _pos_tot = orbit.posTotal(_pos, t);
-       try{
-       otmp = orbit.interp(_pos_tot);
-       }
-       catch (std::runtime_error &e) { //no orbit available: use field without orbit
-	 if (!noorbit) {
-	   cout << e.what() << endl;
-	   noorbit = true;
-	 }
-	 Btmp = lattice[_pos]->B_rf(t); //field without orbit not implemented with edgefields (AccLattice::B())
-	 this->FunctionOfPos<AccTriple>::set(Btmp, _pos, t);
-       }
+  const Sample &d = data[sample];
+  AccTriple field = d.Bstatic;
+  // same operations as B_rf(turn,orbit) * slope in AccLattice::B()
+  for (unsigned int r=0; r<d.nRF; r++) {
+    AccTriple b = d.Brf[r];
+    b *= factor[d.rf[r]][turn-1];
+    b *= d.slope[r];
+    if (r==0 && !d.hasStatic)
+      field = b;
+    else
+      field += b;
+  }
+  return field;
+}
 
-       if (edgefields)
-	 Btmp = lattice.B(_pos_tot,otmp);
-       else
-	 Btmp = lattice[_pos]->B_rf(t,otmp);
+Field SeparableField::expand(const gsl_interp_type *t) const
+{
+  Field field(circ, t);
+  field.info = info;
+  unsigned int n = data.size();
+  double interval_samp = circ / n;
+  field.samplePos.resize(n);
+  for (unsigned int i=0; i<n; i++)
+    field.samplePos[i] = i*interval_samp;
+  field.lastEdgefields = lastEdgefields;
+  {
+    Field::Batch batch(field);
+    field.reserve(n_turns*n);
+    for (unsigned int turn=1; turn<=n_turns; turn++) {
+      for (unsigned int i=0; i<n; i++)
+	field.FunctionOfPos<AccTriple>::set(B(i,turn), field.samplePos[i], turn);
+    }
+  }
+  return field;
+}
 
-       this->FunctionOfPos<AccTriple>::set(Btmp, _pos, t);
-     }
-   }
+// expand turns into spectrum input only
+Spectrum SeparableField::getSpectrum(AccAxis axis, unsigned int fmaxrev, double ampcut, string name) const
+{
+  if (name=="") name = axis_string(axis);
+  vector<double> in;
+  in.reserve(size());
+  for (unsigned int t=1; t<=n_turns; t++) {
+    for (unsigned int i=0; i<data.size(); i++) {
+      AccTriple b = B(i,t);
+      switch(axis) {
+      case x: in.push_back(b.x); break;
+      case z: in.push_back(b.z); break;
+      case s: in.push_back(b.s); break;
+      }
+    }
+  }
+  Spectrum spec(name, in, circ, n_turns, in.size(), fmaxrev, ampcut);
+  for (unsigned int i=2; i<info.size(); i++)
+    spec.info.add(info.getLabel(i), info.getEntry(i));
+  return spec;
 }
 
 
+
 //compare magnet lengths in FIELDMAP with exact lengths from lattice
 //to analyse influence of sampling
 int Field::magnetlengths(AccLattice &lattice, const char *filename) const
@@ -101,7 +648,7 @@ int Field::magnetlengths(AccLattice &lattice, const char *filename) const
   file <<setw(w)<< "Name" <<setw(w)<< "start/mm" <<setw(w) << "end/mm" <<setw(w)<< "length/mm" << endl;
 
 
-  for (std::map<double,AccTriple>::const_iterator it=data.begin(); it!=data.end() && turn(it->first)<2; it++) {
+  for (const_FoPiterator it=data.begin(); it!=data.end() && turn(it->first)<2; it++) {
 
     if ( dipIt.at(it->first) ) {
       tmp_start = it->first;
@@ -21,6 +21,8 @@
 #ifndef __LIBPALATTICE__FIELD_HPP_
 #define __LIBPALATTICE__FIELD_HPP_
 
+#include <vector>
+#include <unordered_map>
 #include "types.hpp"
 #include "FunctionOfPos.hpp"
 #include "AccLattice.hpp"
@@ -28,25 +30,109 @@
 namespace pal
 {
 
+class SeparableField;
+
 class Field : public FunctionOfPos<AccTriple> {
+  friend class SeparableField;
+
+protected:
+  // field of samples [first,last) (sample k: turn k/n+1, position samplePos[k%n] in turn, n=samplePos.size()) written to B[k-first]
+  // rf: rfFactor() of lattice elements for all turns, built once per set() or update() call
+  void setSamples(const AccLattice &lattice, const FunctionOfPos<AccPair> &orbit, const RfFactorTable &rf, bool noorbit, bool edgefields,
+		  unsigned int first, unsigned int last, AccTriple *B) const;
+  typedef std::vector<std::pair<unsigned int,unsigned int>> SampleRanges; // sample ranges [first,last) in one turn
+  bool checkOrbit(FunctionOfPos<AccPair> &orbit, string caller, const SampleRanges &ranges=SampleRanges()) const; // returns noorbit. empty ranges: all samples
+  void setAll(AccLattice &lattice, FunctionOfPos<AccPair> &orbit, bool edgefields, unsigned int n_threads); // all samples at samplePos in all turns
+  std::vector<double> adaptivePositions(const AccLattice &lattice, double accuracy, double maxInterval, bool edgefields) const;
+
+  // settings of last set() or setAdaptive() (used by update())
+  std::vector<double> samplePos;  // sample positions in each turn (ascending)
+  bool lastEdgefields;
+  bool adaptive;                  // samplePos are not equidistant
+  const gsl_interp_type *uniformType; // interpolation type given to constructor, adaptive mode uses gsl_interp_linear
+  Spectrum adaptiveSpectrum(AccAxis axis, unsigned int fmaxrev, double ampcut, string name) const;
 
 public:
   // use FunctionOfPos constructors:
   Field(double circIn=164.4, const gsl_interp_type *t=gsl_interp_akima)
-    : FunctionOfPos(circIn, t) {}
+    : FunctionOfPos(circIn, t), lastEdgefields(true), adaptive(false), uniformType(t) {}
+  Field(const Field &other) = default;
+  Field(Field &&other) = default;
+  Field& operator=(const Field &other) = default;
+  Field& operator=(Field &&other) = default;
   ~Field() {}
 
   
-  void set(AccLattice &lattice, FunctionOfPos<AccPair> &orbit, unsigned int n_samples, bool edgefields=true); // set all magnetic field values from lattice and orbit
+  // set all magnetic field values from lattice and orbit. samples are calculated by n_threads threads (0: number of CPU cores)
+  void set(AccLattice &lattice, FunctionOfPos<AccPair> &orbit, unsigned int n_samples, bool edgefields=true, unsigned int n_threads=FIELD_SET_THREADS);
+
+  // adaptive sampling: dense samples only where the field changes along s, i.e. at magnet edges (edge field width dl()).
+  // sample interval is chosen for linear interpolation error < accuracy*(field of magnet), elsewhere maxInterval / m is used.
+  // the field uses linear interpolation in adaptive mode (interpolation type of constructor is used again by set()).
+  // data is not equidistant, getSpectrum() calculates the exact spectrum of the linear interpolation, see also resample().
+  void setAdaptive(AccLattice &lattice, FunctionOfPos<AccPair> &orbit, double accuracy=1e-4, double maxInterval=0.1, bool edgefields=true,
+		   unsigned int n_threads=FIELD_SET_THREADS);
+  bool isAdaptive() const {return adaptive;}
+  void resample(unsigned int n_samples); // replace data by n_samples equidistant points per turn (interpolation)
+
+  // recalculate only samples influenced by element changed (e.g. after change of its strength) in all turns.
+  // lattice and orbit must be the same as for set()/setAdaptive() apart from the changed element data.
+  // samples between the centers of the neighbouring elements resp. inside the element (edgefields=false in set()) are recalculated.
+  void update(AccLattice &lattice, FunctionOfPos<AccPair> &orbit, AccLattice::const_iterator changed);
 
   int magnetlengths(AccLattice &lattice, const char *filename) const;
 
   // overwrite getSpectrum: equidistant sampling given, no need to set stepwidth
-  Spectrum getSpectrum(AccAxis axis=x, unsigned int fmaxrev=30, double ampcut=0., string name="") const
-  {return FunctionOfPos<AccTriple>::getSpectrum(0,axis,fmaxrev,ampcut,name);}
+  // (adaptive samples see setAdaptive())
+  Spectrum getSpectrum(AccAxis axis=x, unsigned int fmaxrev=30, double ampcut=0., string name="") const;
   Spectrum getSpectrum(unsigned int fmaxrev=30, double ampcut=0., string name="") const
-  {return FunctionOfPos<AccTriple>::getSpectrum(0,fmaxrev,ampcut,name);}
+  {if (name=="") name = this->header()+"-spectrum"; return getSpectrum(pal::x,fmaxrev,ampcut,name);}
+
+};
+
+
+
+// magnetic field of many turns with turn independent orbit (e.g. closed orbit, orbit of turn 1 is used):
+// only one turn is stored as static field plus fields of RF magnets, which are multiplied by rfFactor(turn) on access.
+// memory ~ n_samples + n_turns*(number of RF magnets) instead of n_samples*n_turns for Field.
+// not a FunctionOfPos: there is no field data to interpolate. Use B() and getSpectrum() or expand() to a Field.
+class SeparableField {
+
+protected:
+  // one sample with static field and up to 2 RF magnet fields
+  struct Sample {
+    AccTriple Bstatic;     // sum of fields of non-RF elements
+    bool hasStatic;        // Bstatic is set by any element
+    unsigned int nRF;      // number of RF elements contributing to this sample
+    unsigned int rf[2];    // index of RF element (factor)
+    AccTriple Brf[2];      // field of RF element without rfFactor
+    double slope[2];       // edge field factor of RF element
+    Sample() : hasStatic(false), nRF(0) {}
+  };
+  double circ;
+  unsigned int n_turns;
+  bool lastEdgefields;
+  std::vector<Sample> data;                 // one entry per sample in turn
+  std::vector<std::vector<double>> factor;  // rfFactor(turn) per RF element and turn
+  void add(Sample &sample, const AccElement *e, double slope, const AccPair &orbit,
+	   std::unordered_map<const AccElement*,unsigned int> &rfIndex);
+
+public:
+  Metadata info;
+
+  SeparableField(double circIn=164.4) : circ(circIn), n_turns(0), lastEdgefields(true) {}
+
+  // field of n_turns turns at n_samples positions per turn (same as Field::set() with this orbit repeated in each turn)
+  void set(AccLattice &lattice, FunctionOfPos<AccPair> &orbit, unsigned int n_samples, unsigned int n_turns, bool edgefields=true);
+
+  double circumference() const {return circ;}
+  unsigned int turns() const {return n_turns;}
+  unsigned int samplesInTurn() const {return data.size();}
+  unsigned int size() const {return data.size()*n_turns;}              // number of samples in all turns
 
+  AccTriple B(unsigned int sample, unsigned int turn) const; // field at position sample*circumference/n_samples in turn
+  Field expand(const gsl_interp_type *t=gsl_interp_akima) const; // Field with data of all turns
+  Spectrum getSpectrum(AccAxis axis=x, unsigned int fmaxrev=30, double ampcut=0., string name="") const; // same as expand().getSpectrum()
 };
 
 } //namespace pal
@@ -179,6 +179,7 @@ void FunctionOfPos<AccPair>::elsaClosedOrbit(ELSASpuren &spuren, unsigned int t)
   AccPair otmp;
 
   this->clear(); //delete old-BPM-data
+  Batch batch(*this);
   
   for (i=0; i<NBPMS; i++) {
     if (t > spuren.bpms[i].time.size()) {
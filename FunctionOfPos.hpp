@@ -43,17 +43,21 @@ class FunctionOfPos : public Interpolate<T> {
 
 protected:
   using Interpolate<T>::data;
-  typedef typename std::map<double,T>::iterator FoPiterator;
-  typedef typename std::map<double,T>::const_iterator const_FoPiterator;
+  typedef typename SortedData<T>::iterator FoPiterator;
+  typedef typename SortedData<T>::const_iterator const_FoPiterator;
   
-  //std::map<double,T> data -> is inherited from Interpolate<T>
+  //SortedData<T> data -> is inherited from Interpolate<T>
   unsigned int n_turns;                 //number of turns (initialized as 1)
   double circ;                          //circumference of accelerator
+  unsigned int n_batch;                 //number of existing Batch objects
+  double batchPosMax;                   //largest position set() in batch
+  bool batchSorted;                     //data set() in batch is still sorted
 
 
 private:
   void hide_last_turn() {n_turns-=1;} // reduce turns by one (only do this, if you need pos=0. value to avoid extrapolation for non-periodic function!)
   void circCheck();
+  void endBatch();
   //parts of readSimToolParticleColumn:
   vector<string> getTrajectoryColumns(const SimToolInstance &s, const string &valX, const string &valZ, const string &valS) const;
   double readObsPos(SimToolInstance &s, SimToolTable &tab, const string &trajFile) const;
@@ -68,6 +72,7 @@ public:
   FunctionOfPos(const FunctionOfPos &other) = default;
   FunctionOfPos(FunctionOfPos &&other) = default;
   FunctionOfPos& operator=(const FunctionOfPos &other) = default;
+  FunctionOfPos& operator=(FunctionOfPos &&other) = default;
   ~FunctionOfPos() {}
 
   double circumference() const {return circ;}
@@ -92,6 +97,8 @@ public:
 
   // these functions modify data
   void set(T valueIn, double pos, unsigned int turn=1);        //set (existing or new) value by pos or by pos(1turn) and turn
+  void setMany(const vector<double> &pos, const vector<T> &values, unsigned int turn=1); //set values at pos in turn (one Batch)
+  void reserve(unsigned int n) {data.reserve(n);}               //memory for n datapoints
   void clear();
   void pop_back_turn();  // erase data of last turn, reduces turns by 1
 
@@ -108,6 +115,19 @@ public:
   void madxTrajectory(string madxFile, unsigned int particle, SimToolMode m=online) {SimToolInstance mad(pal::madx, m, madxFile); simToolTrajectory(mad,particle);} //if m=offline, file is only used to get path & output filenames without extension
   void elegantTrajectory(string elegantFile, unsigned int particle, SimToolMode m=online) {SimToolInstance ele(pal::elegant, m, elegantFile); simToolTrajectory(ele,particle);}
 
+  // many set() calls, e.g. for import: as long as a Batch object exists, set() only appends data.
+  // sorting, turns() update and interpolation reset are done once, when the last Batch is destroyed.
+  // data must not be accessed during a Batch.
+  class Batch {
+  private:
+    FunctionOfPos<T> &f;
+  public:
+    Batch(FunctionOfPos<T> &fIn);
+    ~Batch() {if (--f.n_batch == 0) f.endBatch();}
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+  };
+
   // tests
   bool exists(double pos, unsigned int turn=1) const; // is there data at pos?
   bool compatible(const FunctionOfPos<T> &other) const; // can I add/subract with other? (data at same pos?)
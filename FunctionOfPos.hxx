@@ -28,6 +28,7 @@
 #include <fstream>
 #include <iomanip>
 #include <typeinfo>
+#include <limits>
 
 
 using namespace std;
@@ -46,7 +47,7 @@ void FunctionOfPos<T>::circCheck()
 // constructor (set circumference & interpolation)
 template <class T>
 FunctionOfPos<T>::FunctionOfPos(double circIn, const gsl_interp_type *t)
-  : Interpolate<T>::Interpolate(t,circIn), n_turns(1), circ(circIn), verbose(false)
+  : Interpolate<T>::Interpolate(t,circIn), n_turns(1), circ(circIn), n_batch(0), batchPosMax(0.), batchSorted(true), verbose(false)
 {
   circCheck();
   this->info.add("Circumference (set manually)", circ);
@@ -55,7 +56,7 @@ FunctionOfPos<T>::FunctionOfPos(double circIn, const gsl_interp_type *t)
 // constructor (set circumference from SimToolInstance)
 template <class T>
 FunctionOfPos<T>::FunctionOfPos(SimToolInstance &sim, const gsl_interp_type *t)
-  : Interpolate<T>::Interpolate(t), n_turns(1), circ(sim.readCircumference()), verbose(false)
+  : Interpolate<T>::Interpolate(t), n_turns(1), circ(sim.readCircumference()), n_batch(0), batchPosMax(0.), batchSorted(true), verbose(false)
 {
   circCheck();
   this->period = circ; //set period (Interpolate class)
@@ -115,7 +116,7 @@ template <class T>
 T FunctionOfPos<T>::mean() const
 {
   T sum = T();
-  for (auto &d : data)
+  for (const auto &d : data)
     sum += d.second;
   return sum/data.size();
 }
@@ -124,7 +125,7 @@ template <class T>
 T FunctionOfPos<T>::rms() const
 {
   T sum = T();
-  for (auto &d : data)
+  for (const auto &d : data)
     sum += std::pow(d.second,2);
   return std::sqrt( sum/data.size() );
 }
@@ -134,7 +135,7 @@ T FunctionOfPos<T>::stddev() const
 {
   T sum = T();
   T mean = this->mean();
-  for (auto &d : data)
+  for (const auto &d : data)
     sum += std::pow(d.second-mean, 2);
   return std::sqrt( sum/data.size() );
 }
@@ -152,11 +153,7 @@ T FunctionOfPos<T>::get(unsigned int i) const
     msg << "FunctionOfPos<T>::get(): index" << i << "out of data range (" << data.size() <<")";
     throw palatticeError(msg.str());
   }
-  FoPiterator it;
-  for (unsigned int k=0; k<i; k++) {
-    it++;
-  }
-  return it->second;
+  return data.values()[i];
 }
 
 
@@ -165,7 +162,7 @@ T FunctionOfPos<T>::get(unsigned int i) const
 
 
 //set value at given position.
-//map::insert adds new value if keys are not EXACTLY equal,
+//SortedData::insert adds new value if keys are not EXACTLY equal,
 //though "twin-data points" can occur due to numeric accuracy.
 //they do not harm, so are accepted to keep set()-performance
 template <class T>
@@ -173,6 +170,16 @@ void FunctionOfPos<T>::set(T valueIn, double posIn, unsigned int turnIn) {
   std::pair<FoPiterator,bool> ret;
   double pos = posTotal(posIn,turnIn);
 
+  // Batch: append only, see endBatch()
+  if (n_batch > 0) {
+    if (data.size() > 0 && pos <= data.keys().back())
+      batchSorted = false;
+    if (pos > batchPosMax)
+      batchPosMax = pos;
+    data.push_back(pos, valueIn);
+    return;
+  }
+
   // insert data
   ret = data.insert( std::move(std::pair<double,T>(pos, valueIn)) );
   // increase n_turns if necessary
@@ -187,6 +194,46 @@ void FunctionOfPos<T>::set(T valueIn, double posIn, unsigned int turnIn) {
 }
 
 
+// set values at positions pos in turn
+template <class T>
+void FunctionOfPos<T>::setMany(const vector<double> &pos, const vector<T> &values, unsigned int turnIn)
+{
+  if (pos.size() != values.size()) {
+    std::stringstream msg;
+    msg << "FunctionOfPos<T>::setMany(): different number of positions (" << pos.size() << ") and values (" << values.size() << ")";
+    throw palatticeError(msg.str());
+  }
+  Batch batch(*this);
+  reserve(size() + pos.size());
+  for (unsigned int i=0; i<pos.size(); i++)
+    set(values[i], pos[i], turnIn);
+}
+
+
+template <class T>
+FunctionOfPos<T>::Batch::Batch(FunctionOfPos<T> &fIn) : f(fIn)
+{
+  if (f.n_batch == 0) {
+    f.batchPosMax = -std::numeric_limits<double>::infinity();
+    f.batchSorted = true;
+  }
+  f.n_batch++;
+}
+
+// called by destructor of last Batch
+template <class T>
+void FunctionOfPos<T>::endBatch()
+{
+  if (!batchSorted)
+    data.sort();
+  if (data.size() > 0) {
+    unsigned int t = turn(batchPosMax);
+    if (t > turns()) n_turns = t;
+  }
+  this->reset(); //reset interpolation
+}
+
+
 template <class T>
 void FunctionOfPos<T>::clear()
 {
@@ -342,28 +389,28 @@ void FunctionOfPos<T>::operator-=(const FunctionOfPos<T> &other)
 template <class T>
 void FunctionOfPos<T>::operator+=(const T &value)
 {
-  for(auto &it : this->data)
+  for(auto it : this->data)
     it.second += value;
 }
 
 template <class T>
 void FunctionOfPos<T>::operator-=(const T &value)
 {
-  for(auto &it : this->data)
+  for(auto it : this->data)
     it.second -= value;
 }
 
 template <class T>
 void FunctionOfPos<T>::operator*=(const T &value)
 {
-  for(auto &it : this->data)
+  for(auto it : this->data)
     it.second *= value;
 }
 
 template <class T>
 void FunctionOfPos<T>::operator/=(const T &value)
 {
-  for(auto &it : this->data)
+  for(auto it : this->data)
     it.second /= value;
 }
 
@@ -444,15 +491,19 @@ void FunctionOfPos<T>::readSimToolColumn(SimToolInstance &s, string file, string
   
   T tmp;
   auto rows = tab.rows();
-  
-  for (unsigned int i=0; i<rows; i++) {
-    double pos = tab.get<double>(i,posColumn);
-    // values at pos=circ are ignored to avoid #turns problem
-    // see simToolTrajectory() for another solution
-    if (fabs(pos-circumference()) <= 0.0001) continue;
-
-    tmp = tab.get<T>(i, valX, valZ, valS);
-    this->set(tmp, pos);
+
+  {
+    Batch batch(*this);
+    reserve(size() + rows);
+    for (unsigned int i=0; i<rows; i++) {
+      double pos = tab.get<double>(i,posColumn);
+      // values at pos=circ are ignored to avoid #turns problem
+      // see simToolTrajectory() for another solution
+      if (fabs(pos-circumference()) <= 0.0001) continue;
+
+      tmp = tab.get<T>(i, valX, valZ, valS);
+      this->set(tmp, pos);
+    }
   }
   //if (s.tool==elegant) this->pop_back_turn(); //elegant: always entry with s=circumference due to drifts. Avoid additional turn.
 
@@ -493,57 +544,61 @@ void FunctionOfPos<T>::readSimToolParticleColumn(SimToolInstance &s, unsigned in
   if (s.tool==pal::madx) obs=1;
 
   //iterate all existing obs files:
-  while (true) {
-    string trajFile=s.trajectory(obs,particle);
-    if(verbose) cout << "reading file " << trajFile << "\r" << std::flush;
-    try {
-      SimToolTable tab = s.readTable(trajFile, columns);
-      if (s.sddsMode()) {
-	tab.filterRows("particleID", particle, particle);
-      }
+  //data is sorted once after reading all files (Batch)
+  {
+    Batch batch(*this);
+    while (true) {
+      string trajFile=s.trajectory(obs,particle);
+      if(verbose) cout << "reading file " << trajFile << "\r" << std::flush;
+      try {
+	SimToolTable tab = s.readTable(trajFile, columns);
+	if (s.sddsMode()) {
+	  tab.filterRows("particleID", particle, particle);
+	}
     
-      double obsPos = readObsPos(s, tab, trajFile);
+	double obsPos = readObsPos(s, tab, trajFile);
  
-      // write table rows to FunctionOfPos:
-      unsigned int turn;
-      // ------
-      if (s.sddsMode()) {
-	while(true) {
-	  turn = tab.getParameter<unsigned int>("Pass") + 1;      
-	  T otmp = tab.get<T>(0,valX,valZ,valS); //only 1 row per particle
-	  this->set(otmp, obsPos, turn);
-	  try {
-	    tab.nextPage();
-	  }
-	  catch(SDDSPageError) {
-	    break; //next obs point (=next file)
+	// write table rows to FunctionOfPos:
+	unsigned int turn;
+	// ------
+	if (s.sddsMode()) {
+	  while(true) {
+	    turn = tab.getParameter<unsigned int>("Pass") + 1;      
+	    T otmp = tab.get<T>(0,valX,valZ,valS); //only 1 row per particle
+	    this->set(otmp, obsPos, turn);
+	    try {
+	      tab.nextPage();
+	    }
+	    catch(SDDSPageError) {
+	      break; //next obs point (=next file)
+	    }
 	  }
 	}
-      }
-      // ------
-      else {
-	for (unsigned int i=0; i<tab.rows(); i++) {
-	  if (s.tool==pal::madx) {
-	    turn = tab.get<unsigned int>(i,"TURN");
-	    if (obs==1) { //see comment above ("madx & obs0001")
-	      turn += 1;
+	// ------
+	else {
+	  for (unsigned int i=0; i<tab.rows(); i++) {
+	    if (s.tool==pal::madx) {
+	      turn = tab.get<unsigned int>(i,"TURN");
+	      if (obs==1) { //see comment above ("madx & obs0001")
+		turn += 1;
+	      }
 	    }
+	    else if (s.tool==pal::elegant) {
+	      turn = tab.get<unsigned int>(i,"Turn"); // +1 included in elegant2libpalattice.sh
+	    }
+	    else {
+	      throw std::runtime_error("simtool " + s.tool_string() + " not implemented in FunctionOfPos<>::readSimToolParticleColumn()");
+	    }
+	    T otmp = tab.get<T>(i, valX, valZ, valS);
+	    this->set(otmp, obsPos, turn);
 	  }
-	  else if (s.tool==pal::elegant) {
-	    turn = tab.get<unsigned int>(i,"Turn"); // +1 included in elegant2libpalattice.sh
-	  }
-	  else {
-	    throw std::runtime_error("simtool " + s.tool_string() + " not implemented in FunctionOfPos<>::readSimToolParticleColumn()");
-	  }
-	  T otmp = tab.get<T>(i, valX, valZ, valS);
-	  this->set(otmp, obsPos, turn);
 	}
+	// ------
+	obs++;
+      }
+      catch (palatticeFileError) { //thrown by readTable if file not found
+	break;
       }
-      // ------
-      obs++;
-    }
-    catch (palatticeFileError) { //thrown by readTable if file not found
-      break;
     }
   }
 
@@ -32,15 +32,15 @@ using namespace pal;
 template <>
 void Interpolate<double>::initThis()
 {
-  spline.emplace_back( getSpline(data) );
+  spline.emplace_back( getSpline(data.keys(), data.values()) );
 }
 
 //double
 template <>
-double Interpolate<double>::interpThis(double xIn) const
+double Interpolate<double>::interpThis(double xIn, gsl_interp_accel *a) const
 {
   double tmp;
-  tmp = evalSpline(spline[0], xIn);
+  tmp = evalSpline(spline[0], xIn, a);
   return tmp;
 }
 
@@ -50,23 +50,25 @@ double Interpolate<double>::interpThis(double xIn) const
 template <>
 void Interpolate<AccPair>::initThis()
 {
-  std::map<double,double> tmpX, tmpZ;
+  std::vector<double> tmpX, tmpZ;
+  tmpX.reserve(data.size());
+  tmpZ.reserve(data.size());
 
-  for (std::map<double,AccPair>::const_iterator it=data.begin(); it!=data.end(); it++) {
-    tmpX.insert( std::pair<double,double>(it->first, it->second.x) );
-    tmpZ.insert( std::pair<double,double>(it->first, it->second.z) );
+  for (auto &f : data.values()) {
+    tmpX.push_back(f.x);
+    tmpZ.push_back(f.z);
   }
-  spline.emplace_back( getSpline(tmpX) ); // x: spline[0]
-  spline.emplace_back( getSpline(tmpZ) ); // z: spline[1]
+  spline.emplace_back( getSpline(data.keys(), tmpX) ); // x: spline[0]
+  spline.emplace_back( getSpline(data.keys(), tmpZ) ); // z: spline[1]
 }
 
 //AccPair
 template <>
-AccPair Interpolate<AccPair>::interpThis(double xIn) const
+AccPair Interpolate<AccPair>::interpThis(double xIn, gsl_interp_accel *a) const
 {
   AccPair tmp;
-  tmp.x = evalSpline(spline[0], xIn);  // x: spline[0]
-  tmp.z = evalSpline(spline[1], xIn);  // z: spline[1]
+  tmp.x = evalSpline(spline[0], xIn, a);  // x: spline[0]
+  tmp.z = evalSpline(spline[1], xIn, a);  // z: spline[1]
   return tmp;
 }
 
@@ -76,26 +78,29 @@ AccPair Interpolate<AccPair>::interpThis(double xIn) const
 template <>
 void Interpolate<AccTriple>::initThis()
 {
-  std::map<double,double> tmpX, tmpZ, tmpS;
-
-  for (std::map<double,AccTriple>::const_iterator it=data.begin(); it!=data.end(); it++) {
-    tmpX.insert( std::pair<double,double>(it->first, it->second.x) );
-    tmpZ.insert( std::pair<double,double>(it->first, it->second.z) );
-    tmpS.insert( std::pair<double,double>(it->first, it->second.s) );
+  std::vector<double> tmpX, tmpZ, tmpS;
+  tmpX.reserve(data.size());
+  tmpZ.reserve(data.size());
+  tmpS.reserve(data.size());
+
+  for (auto &f : data.values()) {
+    tmpX.push_back(f.x);
+    tmpZ.push_back(f.z);
+    tmpS.push_back(f.s);
   }
-  spline.emplace_back( getSpline(tmpX) ); // x: spline[0]
-  spline.emplace_back( getSpline(tmpZ) ); // z: spline[1]
-  spline.emplace_back( getSpline(tmpS) ); // s: spline[2]
+  spline.emplace_back( getSpline(data.keys(), tmpX) ); // x: spline[0]
+  spline.emplace_back( getSpline(data.keys(), tmpZ) ); // z: spline[1]
+  spline.emplace_back( getSpline(data.keys(), tmpS) ); // s: spline[2]
 }
 
 //AccTriple
 template <>
-AccTriple Interpolate<AccTriple>::interpThis(double xIn) const
+AccTriple Interpolate<AccTriple>::interpThis(double xIn, gsl_interp_accel *a) const
 {
   AccTriple tmp;
-  tmp.x = evalSpline(spline[0], xIn);  // x: spline[0]
-  tmp.z = evalSpline(spline[1], xIn);  // z: spline[1]
-  tmp.s = evalSpline(spline[2], xIn);  // s: spline[2]
+  tmp.x = evalSpline(spline[0], xIn, a);  // x: spline[0]
+  tmp.z = evalSpline(spline[1], xIn, a);  // z: spline[1]
+  tmp.s = evalSpline(spline[2], xIn, a);  // s: spline[2]
   return tmp;
 }
 
@@ -31,15 +31,30 @@
 #include <gsl/gsl_spline.h>
 #include "types.hpp"
 #include "Metadata.hpp"
+#include "SortedData.hpp"
 
 namespace pal
 {
 
+// gsl interpolation accelerator (caches index of last lookup).
+// one per thread for concurrent Interpolate::interp(x,acc) const.
+class InterpAccel {
+private:
+  gsl_interp_accel *acc;
+public:
+  InterpAccel() : acc(gsl_interp_accel_alloc()) {}
+  ~InterpAccel() {gsl_interp_accel_free(acc);}
+  InterpAccel(const InterpAccel&) = delete;
+  InterpAccel& operator=(const InterpAccel&) = delete;
+  operator gsl_interp_accel*() const {return acc;}
+};
+
+
 template <class T=double>
 class Interpolate {
 
 protected:
-  std::map<double,T> data;
+  SortedData<T> data;
   std::string headerString;
   double period;
   bool ready;
@@ -50,10 +65,10 @@ private:
   gsl_interp_accel *acc;
   std::vector<gsl_spline*> spline;  //several splines for multidimensional data types
 
-  gsl_spline* getSpline(std::map<double,double> data1D);
-  double evalSpline(gsl_spline *s, double xIn) const;
+  gsl_spline* getSpline(const std::vector<double> &x, const std::vector<double> &f);
+  double evalSpline(gsl_spline *s, double xIn, gsl_interp_accel *a) const;
   void initThis();
-  T interpThis(double xIn) const;
+  T interpThis(double xIn, gsl_interp_accel *a) const;
 
 
 public:
@@ -63,6 +78,7 @@ public:
   Interpolate(const Interpolate &other);
   Interpolate(Interpolate &&other);
   Interpolate& operator=(const Interpolate &other);
+  Interpolate& operator=(Interpolate &&other);
   virtual ~Interpolate();
 
   // access data without interpolation
@@ -71,12 +87,16 @@ public:
 
   // manual initialization of interpolation
   void init();
+  bool initialized() const {return ready;}
 
   // access interpolated data
   // non const version initializes interpolation automatically if not done before
-  // const version requires init() to be called before.
+  // const versions require init() to be called before. They are thread-safe:
+  // without accelerator each call does a binary search, with acc the index of the last call is used
+  // (fast for increasing xIn, each thread needs its own acc, see InterpAccel).
   T interp(double xIn);
   T interp(double xIn) const;
+  T interp(double xIn, gsl_interp_accel *a) const;
 
   // periodic interpolation: avoiding extrapolation my mapping xIn into interpRange:
   inline T interpPeriodic(double xIn)       { while(xIn<interpMin()) {xIn+=interpRange();} return interp(interpMin()+std::fmod(xIn-interpMin(), interpRange())); }
@@ -84,6 +104,7 @@ public:
 
   // reset initialization (for derived classes that can change data)
   void reset();
+  void setType(const gsl_interp_type *t); // change interpolation type (resets initialization)
   void reset(std::map<double,T> dataIn, double periodIn=0.); // directly insert new external data
 
   // info
@@ -107,11 +128,11 @@ public:
 // template function specializations
 // interpolation is only implemented for these data types
 template<> void Interpolate<double>::initThis();
-template<> double Interpolate<double>::interpThis(double xIn) const;
+template<> double Interpolate<double>::interpThis(double xIn, gsl_interp_accel *a) const;
 template<> void Interpolate<AccPair>::initThis();
-template<> AccPair Interpolate<AccPair>::interpThis(double xIn) const;
+template<> AccPair Interpolate<AccPair>::interpThis(double xIn, gsl_interp_accel *a) const;
 template<> void Interpolate<AccTriple>::initThis();
-template<> AccTriple Interpolate<AccTriple>::interpThis(double xIn) const;
+template<> AccTriple Interpolate<AccTriple>::interpThis(double xIn, gsl_interp_accel *a) const;
 template<> std::string Interpolate<AccPair>::header() const;
 template<> std::string Interpolate<AccTriple>::header() const;
 
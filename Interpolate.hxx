@@ -26,6 +26,7 @@
 #include <iomanip>
 #include <cmath>
 #include <sstream>
+#include <algorithm>
 
 using namespace std;
 using namespace pal;
@@ -58,29 +59,59 @@ Interpolate<T>::Interpolate(const Interpolate &other)
 }
 
 // move constructor
+// acc and initialized splines are taken from other, no new initialization needed
 template <class T>
 Interpolate<T>::Interpolate(Interpolate &&other)
-  : data(std::move(other.data)), headerString(std::move(other.headerString)), period(std::move(other.period)), ready(std::move(other.ready)), periodic(std::move(other.periodic)), type(std::move(other.type)), info(std::move(other.info))
+  : data(std::move(other.data)), headerString(std::move(other.headerString)), period(other.period), ready(other.ready), periodic(other.periodic), type(other.type), acc(other.acc), spline(std::move(other.spline)), info(std::move(other.info))
 {
-  acc = other.acc;
-  other.acc=nullptr;
-  //  std::cout << "move it!" << std::endl;
+  other.acc = nullptr;
+  other.spline.clear();
+  other.ready = false;
 }
 
 // assignment operator
 template<class T>
 Interpolate<T>& Interpolate<T>::operator=(const Interpolate &other)
 {
+  if (this == &other)
+    return *this;
+
+  reset();
   data = other.data;
   headerString = other.headerString;
   type = other.type;
   periodic = other.periodic;
   period = other.period;
-  ready = false;
   info = other.info;
 
-  acc = gsl_interp_accel_alloc ();
-  // by setting ready=false spline is initialized again before beeing used
+  if (acc == nullptr)
+    acc = gsl_interp_accel_alloc ();
+  else
+    gsl_interp_accel_reset (acc);
+  // by setting ready=false (reset()) spline is initialized again before beeing used
+  return *this;
+}
+
+// move assignment operator
+// acc and initialized splines are swapped with other, no new initialization needed
+template<class T>
+Interpolate<T>& Interpolate<T>::operator=(Interpolate &&other)
+{
+  if (this == &other)
+    return *this;
+
+  data = std::move(other.data);
+  headerString = std::move(other.headerString);
+  type = other.type;
+  periodic = other.periodic;
+  period = other.period;
+  info = std::move(other.info);
+
+  std::swap(acc, other.acc);
+  std::swap(spline, other.spline);
+  std::swap(ready, other.ready);
+  other.reset();
+  return *this;
 }
 
 
@@ -95,11 +126,13 @@ Interpolate<T>::~Interpolate()
 
 
 //initialize interpolation for double type data
+//x are the keys of data, f one component of the data values
 template <class T>
-gsl_spline* Interpolate<T>::getSpline(std::map<double,double> data1D)
+gsl_spline* Interpolate<T>::getSpline(const std::vector<double> &x, const std::vector<double> &f)
 {
-  double *xTmp;
-  double *fTmp;
+  const std::vector<double> *xTmp = &x;
+  const std::vector<double> *fTmp = &f;
+  std::vector<double> xPeriodic, fPeriodic;
 
   // periodic boundary conditions
   if (periodic) {
@@ -117,32 +150,30 @@ gsl_spline* Interpolate<T>::getSpline(std::map<double,double> data1D)
     }
 
     // add datapoints to avoid extrapolation, if they do not exist already
-    std::pair<double,double> begin = *data1D.begin();
-    std::pair<double,double> lastInPeriod = *(--data1D.upper_bound(period));
+    xPeriodic = x;
+    fPeriodic = f;
+    auto add = [&](double xIn, double fIn) {
+      auto it = std::lower_bound(xPeriodic.begin(), xPeriodic.end(), xIn);
+      if (it != xPeriodic.end() && *it == xIn)
+	return;
+      fPeriodic.insert(fPeriodic.begin() + (it-xPeriodic.begin()), fIn);
+      xPeriodic.insert(it, xIn);
+    };
+    unsigned int lastInPeriod = std::upper_bound(x.begin(), x.end(), period) - x.begin();
+    if (lastInPeriod > 0) lastInPeriod--;
     // add datapoint BEFORE range (!interpMin/Max functions affected!)
-    data1D.insert( std::pair<double,double>(lastInPeriod.first-period, lastInPeriod.second) );
+    add(x[lastInPeriod]-period, f[lastInPeriod]);
     // add datapoint AFTER range (!interpMin/Max functions affected!)
-    data1D.insert( std::pair<double,double>(period+begin.first, begin.second) );
+    add(period+x.front(), f.front());
+    xTmp = &xPeriodic;
+    fTmp = &fPeriodic;
   }// (end periodic boundary conditions)
-  
-  // write data to double arrays for gsl spline
-  unsigned int n = data1D.size();
-  xTmp = new double[n];
-  fTmp = new double[n];
-  std::map<double,double>::const_iterator it=data1D.begin();
-  for (unsigned int i=0; i<n; i++) {
-    xTmp[i] = it->first;
-    fTmp[i] = it->second;
-    it++;
-  }
 
   // initialize interpolation
+  unsigned int n = xTmp->size();
   gsl_spline *newSpline = gsl_spline_alloc (type, n);
-  gsl_spline_init (newSpline, xTmp, fTmp, n);
+  gsl_spline_init (newSpline, xTmp->data(), fTmp->data(), n);
 
-  delete[] xTmp;
-  delete[] fTmp;
-  
   return newSpline;
 }
 
@@ -150,13 +181,14 @@ gsl_spline* Interpolate<T>::getSpline(std::map<double,double> data1D)
 
 
 // evaluate spline s at xIn (double type result)
+// a=nullptr: no accelerator (binary search)
 template <class T>
-double Interpolate<T>::evalSpline(gsl_spline *s, double xIn) const
+double Interpolate<T>::evalSpline(gsl_spline *s, double xIn, gsl_interp_accel *a) const
 {
   double tmp;
   stringstream msg;
   if ( xIn >= interpMin() && xIn <= interpMax() )
-    tmp =  gsl_spline_eval (s, xIn, acc);
+    tmp =  gsl_spline_eval (s, xIn, a);
   else {
     msg << "ERROR: Interpolate<T>::evalSpline(): Extrapolation instead of Interpolation requested @ key=" <<xIn<< endl;
     throw range_error(msg.str());
@@ -204,17 +236,24 @@ T Interpolate<T>::interp(double xIn)
     init();
   }
 
-  return interpThis(xIn);
+  return interpThis(xIn, acc);
 }
 
+// const: member acc is not used (thread-safe)
 template <class T>
 T Interpolate<T>::interp(double xIn) const
+{
+  return interp(xIn, nullptr);
+}
+
+template <class T>
+T Interpolate<T>::interp(double xIn, gsl_interp_accel *a) const
 {
   if (!ready) {
     throw palatticeError("ERROR: Interpolate<>:interp_const(): Interpolation cannot be initialized by this const (!) function.");
   }
-  
-  return interpThis(xIn);
+
+  return interpThis(xIn, a);
 }
 
 
@@ -235,6 +274,19 @@ void Interpolate<T>::reset()
 
 
 
+// change of interpolation type
+template <class T>
+void Interpolate<T>::setType(const gsl_interp_type *t)
+{
+  if (t == type)
+    return;
+  reset();
+  type = t;
+  periodic = (type == gsl_interp_akima_periodic || type == gsl_interp_cspline_periodic);
+}
+
+
+
 // change of data and Interpolation reset
 template <class T>
 void Interpolate<T>::reset(std::map<double,T> dataIn, double periodIn)
@@ -364,7 +416,7 @@ void Interpolate<T>::initThis()
 }
 
 template <class T>
-T Interpolate<T>::interpThis(double) const
+T Interpolate<T>::interpThis(double, gsl_interp_accel*) const
 {
   throw palatticeError("ERROR: Interpolate<>:interpThis(): Interpolation is not implemented for this data type.");
 }
@@ -0,0 +1,127 @@
+/* NameMatcher Class
+ * List of element name patterns (can contain 1 wildcard * per entry), compiled for fast matching.
+ * Used for AccLattice ignore list and AccLattice::setFamily().
+ *
+ * Copyright (C) 2016 Jan Felix Schmidt <janschmidt@mailbox.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utility>
+#include "NameMatcher.hpp"
+
+using namespace pal;
+
+
+NameMatcher::NameMatcher(const std::vector<std::string> &patterns)
+  : prefixTrie(1), suffixTrie(1), n(0)
+{
+  add(patterns);
+}
+
+
+// insert characters [first,last) into trie (node 0 is root)
+template <class It>
+unsigned int NameMatcher::insert(std::vector<Node> &trie, It first, It last)
+{
+  unsigned int node = 0;
+  for (It c=first; c!=last; ++c) {
+    auto next = trie[node].next.find(*c);
+    if (next == trie[node].next.end()) {
+      trie.push_back(Node());
+      next = trie[node].next.insert(std::make_pair(*c, trie.size()-1)).first;
+    }
+    node = next->second;
+  }
+  trie[node].end = true;
+  return node;
+}
+
+void NameMatcher::add(const std::string &pattern)
+{
+  n++;
+  size_t wildcardPos = pattern.find("*");
+  if (wildcardPos == std::string::npos) {
+    exact.insert(pattern);
+    return;
+  }
+
+  unsigned int p = insert(prefixTrie, pattern.begin(), pattern.begin()+wildcardPos);
+  unsigned int s = insert(suffixTrie, pattern.rbegin(), pattern.rend()-wildcardPos-1);
+  wildcards.insert(key(p,s));
+}
+
+void NameMatcher::add(const std::vector<std::string> &patterns)
+{
+  for (auto &p : patterns)
+    add(p);
+}
+
+void NameMatcher::clear()
+{
+  exact.clear();
+  prefixTrie.assign(1, Node());
+  suffixTrie.assign(1, Node());
+  wildcards.clear();
+  n = 0;
+}
+
+
+
+bool NameMatcher::match(const std::string &name) const
+{
+  if (exact.count(name) > 0)
+    return true;
+  if (wildcards.empty())
+    return false;
+
+  // all pattern prefixes/suffixes of name: (node, length)
+  std::vector<std::pair<unsigned int,unsigned int>> prefixes, suffixes;
+  unsigned int node = 0;
+  for (unsigned int i=0; ; i++) {
+    if (prefixTrie[node].end)
+      prefixes.push_back(std::make_pair(node,i));
+    if (i == name.size())
+      break;
+    auto next = prefixTrie[node].next.find(name[i]);
+    if (next == prefixTrie[node].next.end())
+      break;
+    node = next->second;
+  }
+  if (prefixes.empty())
+    return false;
+
+  node = 0;
+  for (unsigned int i=0; ; i++) {
+    if (suffixTrie[node].end)
+      suffixes.push_back(std::make_pair(node,i));
+    if (i == name.size())
+      break;
+    auto next = suffixTrie[node].next.find(name[name.size()-1-i]);
+    if (next == suffixTrie[node].next.end())
+      break;
+    node = next->second;
+  }
+
+  // prefix and suffix must not overlap
+  for (auto &p : prefixes) {
+    for (auto &s : suffixes) {
+      if (p.second + s.second > name.size())
+	break;
+      if (wildcards.count(key(p.first,s.first)) > 0)
+	return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,75 @@
+/* NameMatcher Class
+ * List of element name patterns (can contain 1 wildcard * per entry), compiled for fast matching.
+ * Used for AccLattice ignore list and AccLattice::setFamily().
+ *
+ * Copyright (C) 2016 Jan Felix Schmidt <janschmidt@mailbox.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * Same matching as AccElement::nameMatch(): a pattern without wildcard matches
+ * the equal name, a pattern "before*after" matches all names beginning with "before"
+ * and ending with "after" (non-overlapping). Only the first * is a wildcard.
+ *
+ * Patterns without wildcard are stored in a hash set. For patterns with wildcard
+ * all "before" parts are stored in a prefix trie and all "after" parts (reversed) in a suffix trie.
+ * A name is matched by walking both tries along the name (-> all matching prefixes and suffixes)
+ * and looking up the (prefix,suffix) combinations. Time depends on name length only, not on number of patterns.
+ */
+
+#ifndef __LIBPALATTICE_NAMEMATCHER_HPP_
+#define __LIBPALATTICE_NAMEMATCHER_HPP_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <cstdint>
+
+namespace pal
+{
+
+  class NameMatcher {
+  protected:
+    struct Node {
+      std::map<char,unsigned int> next;
+      bool end;                          // a pattern part ends here
+      Node() : end(false) {}
+    };
+    std::unordered_set<std::string> exact;      // patterns without wildcard
+    std::vector<Node> prefixTrie;                // "before" parts of wildcard patterns
+    std::vector<Node> suffixTrie;                // "after" parts of wildcard patterns (reversed)
+    std::unordered_set<uint64_t> wildcards;      // (prefix node, suffix node) of each wildcard pattern
+    unsigned int n;
+
+    template <class It> static unsigned int insert(std::vector<Node> &trie, It first, It last); // returns node of last character
+    static uint64_t key(unsigned int prefixNode, unsigned int suffixNode) {return (uint64_t(prefixNode)<<32) | suffixNode;}
+
+  public:
+    NameMatcher() : prefixTrie(1), suffixTrie(1), n(0) {}
+    explicit NameMatcher(const std::vector<std::string> &patterns);
+
+    void add(const std::string &pattern);
+    void add(const std::vector<std::string> &patterns);
+    void clear();
+
+    bool match(const std::string &name) const;  // true if name matches any pattern
+    unsigned int size() const {return n;}        // number of added patterns
+    bool empty() const {return n==0;}
+  };
+
+} //namespace pal
+
+#endif
+/*__LIBPALATTICE_NAMEMATCHER_HPP_*/
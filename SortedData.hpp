@@ -0,0 +1,150 @@
+/* SortedData Class
+ * data f(x) sorted by x, stored in contiguous arrays (one for x, one for f).
+ * Replaces std::map<double,T> as data storage of Interpolate & FunctionOfPos:
+ * no memory overhead per datapoint, fast iteration and binary search.
+ * Interface is a subset of std::map. Appending data (increasing x) is fast,
+ * insertion in between has to move all following datapoints
+ * (use push_back() and sort() for many unsorted datapoints).
+ *
+ * Copyright (C) 2016 Jan Felix Schmidt <janschmidt@mailbox.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ * iterators dereference to a proxy with references "first" (x, const) and "second" (f),
+ * so use "const auto &d" or "auto d" instead of "auto &d" in range-based for loops.
+ */
+
+#ifndef __LIBPALATTICE_SORTEDDATA_HPP_
+#define __LIBPALATTICE_SORTEDDATA_HPP_
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+
+namespace pal
+{
+
+template <class T>
+class SortedData {
+
+protected:
+  std::vector<double> _x; // ascending
+  std::vector<T> _f;
+
+  // V is T or const T
+  template <class V>
+  class Iterator {
+  public:
+    struct Entry {
+      const double &first;
+      V &second;
+    };
+    struct Arrow {       // returned by operator->
+      Entry e;
+      Entry* operator->() {return &e;}
+    };
+
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef Entry value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef Arrow pointer;
+    typedef Entry reference;
+
+    Iterator() : x(nullptr), f(nullptr) {}
+    Iterator(const double *xIn, V *fIn) : x(xIn), f(fIn) {}
+    template <class W> Iterator(const Iterator<W> &o) : x(o.x), f(o.f) {} // iterator -> const_iterator
+
+    Entry operator*() const {return Entry{*x, *f};}
+    Arrow operator->() const {return Arrow{Entry{*x, *f}};}
+    Entry operator[](difference_type n) const {return Entry{x[n], f[n]};}
+
+    Iterator& operator++() {++x; ++f; return *this;}
+    Iterator& operator--() {--x; --f; return *this;}
+    Iterator operator++(int) {Iterator tmp(*this); ++(*this); return tmp;}
+    Iterator operator--(int) {Iterator tmp(*this); --(*this); return tmp;}
+    Iterator& operator+=(difference_type n) {x+=n; f+=n; return *this;}
+    Iterator& operator-=(difference_type n) {x-=n; f-=n; return *this;}
+    Iterator operator+(difference_type n) const {return Iterator(x+n, f+n);}
+    Iterator operator-(difference_type n) const {return Iterator(x-n, f-n);}
+    template <class W> difference_type operator-(const Iterator<W> &o) const {return x - o.x;}
+
+    template <class W> bool operator==(const Iterator<W> &o) const {return x == o.x;}
+    template <class W> bool operator!=(const Iterator<W> &o) const {return x != o.x;}
+    template <class W> bool operator<(const Iterator<W> &o) const {return x < o.x;}
+    template <class W> bool operator>(const Iterator<W> &o) const {return x > o.x;}
+    template <class W> bool operator<=(const Iterator<W> &o) const {return x <= o.x;}
+    template <class W> bool operator>=(const Iterator<W> &o) const {return x >= o.x;}
+
+    const double *x;
+    V *f;
+  };
+
+public:
+  typedef Iterator<T> iterator;
+  typedef Iterator<const T> const_iterator;
+  typedef std::reverse_iterator<iterator> reverse_iterator;
+  typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  SortedData() {}
+  SortedData(const std::map<double,T> &m);
+  operator std::map<double,T>() const;
+
+  unsigned int size() const {return _x.size();}
+  bool empty() const {return _x.empty();}
+  void clear() {_x.clear(); _f.clear();}
+  void reserve(unsigned int n) {_x.reserve(n); _f.reserve(n);}
+  unsigned int capacity() const {return _x.capacity();}
+  void shrink_to_fit() {_x.shrink_to_fit(); _f.shrink_to_fit();}
+
+  // contiguous arrays, e.g. for gsl
+  const std::vector<double>& keys() const {return _x;}
+  const std::vector<T>& values() const {return _f;}
+
+  iterator begin() {return iterator(_x.data(), _f.data());}
+  iterator end() {return begin() + _x.size();}
+  const_iterator begin() const {return const_iterator(_x.data(), _f.data());}
+  const_iterator end() const {return begin() + _x.size();}
+  reverse_iterator rbegin() {return reverse_iterator(end());}
+  reverse_iterator rend() {return reverse_iterator(begin());}
+  const_reverse_iterator rbegin() const {return const_reverse_iterator(end());}
+  const_reverse_iterator rend() const {return const_reverse_iterator(begin());}
+
+  iterator lower_bound(double x);              // first element with key >= x
+  const_iterator lower_bound(double x) const;
+  iterator upper_bound(double x);              // first element with key > x
+  const_iterator upper_bound(double x) const;
+  iterator find(double x);
+  const_iterator find(double x) const;
+  unsigned int count(double x) const {return find(x)!=end();}
+
+  // as std::map::insert: no change if key exists, second=false
+  // fast path for x > last key (append)
+  std::pair<iterator,bool> insert(const std::pair<double,T> &d);
+  void push_back(double x, const T &f); // no sorting. if x <= last key, sort() must be called before any other access
+  void sort();                          // sort after unsorted push_back(). for equal keys the last pushed value is kept
+  T& operator[](double x);
+
+  iterator erase(const_iterator first, const_iterator last);
+  iterator erase(const_iterator pos) {return erase(pos, pos+1);}
+};
+
+} //namespace pal
+
+#include "SortedData.hxx"
+
+#endif
+/*__LIBPALATTICE_SORTEDDATA_HPP_*/
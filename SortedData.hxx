@@ -0,0 +1,158 @@
+/* SortedData Class
+ * data f(x) sorted by x, stored in contiguous arrays (one for x, one for f).
+ *
+ * Copyright (C) 2016 Jan Felix Schmidt <janschmidt@mailbox.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+namespace pal
+{
+
+template <class T>
+SortedData<T>::SortedData(const std::map<double,T> &m)
+{
+  reserve(m.size());
+  for (auto &d : m)
+    push_back(d.first, d.second);
+}
+
+template <class T>
+SortedData<T>::operator std::map<double,T>() const
+{
+  std::map<double,T> m;
+  for (unsigned int i=0; i<size(); i++)
+    m.insert(m.end(), std::make_pair(_x[i], _f[i]));
+  return m;
+}
+
+
+
+template <class T>
+typename SortedData<T>::iterator SortedData<T>::lower_bound(double x)
+{
+  return begin() + (std::lower_bound(_x.begin(), _x.end(), x) - _x.begin());
+}
+
+template <class T>
+typename SortedData<T>::const_iterator SortedData<T>::lower_bound(double x) const
+{
+  return begin() + (std::lower_bound(_x.begin(), _x.end(), x) - _x.begin());
+}
+
+template <class T>
+typename SortedData<T>::iterator SortedData<T>::upper_bound(double x)
+{
+  return begin() + (std::upper_bound(_x.begin(), _x.end(), x) - _x.begin());
+}
+
+template <class T>
+typename SortedData<T>::const_iterator SortedData<T>::upper_bound(double x) const
+{
+  return begin() + (std::upper_bound(_x.begin(), _x.end(), x) - _x.begin());
+}
+
+template <class T>
+typename SortedData<T>::iterator SortedData<T>::find(double x)
+{
+  iterator it = lower_bound(x);
+  if (it != end() && it->first == x)
+    return it;
+  return end();
+}
+
+template <class T>
+typename SortedData<T>::const_iterator SortedData<T>::find(double x) const
+{
+  const_iterator it = lower_bound(x);
+  if (it != end() && it->first == x)
+    return it;
+  return end();
+}
+
+
+
+template <class T>
+std::pair<typename SortedData<T>::iterator,bool> SortedData<T>::insert(const std::pair<double,T> &d)
+{
+  if (empty() || d.first > _x.back()) { // append
+    push_back(d.first, d.second);
+    return std::make_pair(end()-1, true);
+  }
+
+  unsigned int i = std::lower_bound(_x.begin(), _x.end(), d.first) - _x.begin();
+  if (_x[i] == d.first)
+    return std::make_pair(begin()+i, false);
+  _x.insert(_x.begin()+i, d.first);
+  _f.insert(_f.begin()+i, d.second);
+  return std::make_pair(begin()+i, true);
+}
+
+template <class T>
+void SortedData<T>::push_back(double x, const T &f)
+{
+  _x.push_back(x);
+  _f.push_back(f);
+}
+
+template <class T>
+void SortedData<T>::sort()
+{
+  unsigned int n = size();
+  unsigned int i = 1;
+  while (i<n && _x[i-1] < _x[i])
+    i++;
+  if (i >= n) // already sorted, no duplicates
+    return;
+
+  std::vector<unsigned int> index(n);
+  for (i=0; i<n; i++)
+    index[i] = i;
+  std::stable_sort(index.begin(), index.end(), [this](unsigned int a, unsigned int b) {return _x[a] < _x[b];});
+
+  std::vector<double> x;
+  std::vector<T> f;
+  x.reserve(n);
+  f.reserve(n);
+  for (unsigned int k : index) {
+    if (!x.empty() && x.back() == _x[k])
+      f.back() = _f[k];
+    else {
+      x.push_back(_x[k]);
+      f.push_back(_f[k]);
+    }
+  }
+  _x.swap(x);
+  _f.swap(f);
+}
+
+template <class T>
+T& SortedData<T>::operator[](double x)
+{
+  return insert(std::make_pair(x, T())).first->second;
+}
+
+template <class T>
+typename SortedData<T>::iterator SortedData<T>::erase(const_iterator first, const_iterator last)
+{
+  unsigned int i = first - begin();
+  unsigned int j = last - begin();
+  _x.erase(_x.begin()+i, _x.begin()+j);
+  _f.erase(_f.begin()+i, _f.begin()+j);
+  return begin() + i;
+}
+
+} //namespace pal
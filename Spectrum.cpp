@@ -229,7 +229,7 @@ void Spectrum::setFMax_rev(unsigned int fmaxrevIn)
 
 
 
-void Spectrum::setLength(double length, unit u)
+void Spectrum::setLength(double length, unit u, unsigned int turnsIn)
 {
   if (size() > 0)
     throw palatticeError("Spectrum::setLength() Existing components would change their frequency!");
@@ -237,7 +237,7 @@ void Spectrum::setLength(double length, unit u)
   //or: clear()
 
   circ = length;
-  turns = 1;
+  turns = turnsIn;
   circUnit = u;
   norm = 1;
 }
@@ -74,6 +74,10 @@ public:
 
   Spectrum(string _name, unsigned int fmaxrevIn=30, double ampcut=0);
   Spectrum(string _name, vector<double> In, double circ, unsigned int turns, int _norm=-1, unsigned int fmaxrevIn=30, double ampcut=0, unit u=meter);
+  Spectrum(const Spectrum &other) = default;
+  Spectrum(Spectrum &&other) = default;
+  Spectrum& operator=(const Spectrum &other) = default;
+  Spectrum& operator=(Spectrum &&other) = default;
   ~Spectrum() {}
   
   inline FREQCOMP get(unsigned int i) const {return b[i];}
@@ -91,7 +95,7 @@ public:
 
   void setAmpcut(double ampcutIn);
   void setFMax_rev(unsigned int fmaxrevIn);
-  void setLength(double length, unit u=meter);
+  void setLength(double length, unit u=meter, unsigned int turnsIn=1); // circumference and number of turns (of data)
   void push_back(FREQCOMP tmp);      // add FREQCOMP manually
   void clear() {b.clear();}
 
@@ -31,6 +31,10 @@
 
 #define VCPOS_WARNDIFF 0.05            // ELSAimport: warning for larger VC pos.diff. in MadX & ELSA-Spuren
 #define DEFAULT_LENGTH_DIFFERENCE 0.09 // default for AccElement "effective-minus-physical" length in m (if no physical length is set)
+#define EDGEFIELD_SLOPE_TOLERANCE 1e-10 // max. deviation of tabulated edge field slope (AccLattice::B()) from Gaussian (0: no table)
+#define ELEMENTPOOL_CHUNK_SIZE 65536   // memory chunk size / bytes of AccElementPool (AccLattice element storage)
+#define FIELD_SET_THREADS 1            // default number of threads for Field::set() (0: number of CPU cores)
+#define FIELD_SET_MIN_SAMPLES_PER_THREAD 10000 // Field::set() with automatic number of threads uses less threads for less samples
 
 
 #endif
@@ -29,6 +29,10 @@
 
 #include "AccIterator.hpp"   // special iterator to access and iterate AccLattice
 
+#include "CompiledLattice.hpp" // immutable flat-array snapshot of AccLattice for fast position lookup & field evaluation in loops
+
+#include "NameMatcher.hpp"   // list of element name patterns (with wildcard *), compiled for fast matching. used by AccLattice ignore list.
+
 #include "FunctionOfPos.hpp" // data of any type as a function of position (and turn) in a particle accelerator (e.g. orbit,trajectory,twiss). Interpolation and Spectrum (FFT) included.
 
 #include "Spectrum.hpp"      // spectrum of any data, calculated by GSL FFT. used by FunctionOfPos.
@@ -39,6 +43,8 @@
 
 #include "Interpolate.hpp"   // interpolateable data. wrapper for GSL interpolation. used by FunctionOfPos.
 
+#include "SortedData.hpp"    // data f(x) sorted by x in contiguous arrays. data storage of Interpolate.
+
 #include "Metadata.hpp"      // arbitrary meta-information (strings) as label/entry pairs with formatted output. used by AccLattice, FunctionOfPos and Spectrum.
 
 #include "ELSASpuren.hpp"    // data structure for Closed Orbit and vert. Corrector Kicks measurement of one ELSA cycle from ELSA Control System. import included.
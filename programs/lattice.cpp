@@ -63,11 +63,12 @@ int main(int argc, char *argv[])
 
   // lattice iterators
   // access position via it.pos()
-  // access AccElement* via it.element() or *it
+  // access AccElement* via it.element() or *it (read only, const AccElement*)
+  // write access via it.modify() (non-const iterators only)
   std::cout <<std::endl<< "types of elements mounted in beamline:" << std::endl;
   for (auto it=beamline.begin(); it!=beamline.end(); ++it) {
     // it is pal::AccLattice::iterator
-    std::cout << it.pos() << "m: " << it.element()->type_string() << std::endl;
+    std::cout << it.pos() << "m: " << (*it)->type_string() << std::endl;
   }
 
   // lattice type iterators
@@ -0,0 +1,45 @@
+#include "gtest/gtest.h"
+#include "../AccElements.hpp"
+
+#include <vector>
+
+TEST(AccElementPool, createDestroy) {
+  pal::AccElementPool pool(1024);
+  std::vector<pal::AccElement*> e;
+  for (unsigned int i=0; i<20; i++)
+    e.push_back(pal::Quadrupole("Q", 0.5, pal::F, i).clone(pool));
+  EXPECT_EQ(20u, pool.size());
+  EXPECT_EQ(7., e[7]->k1);
+  pal::AccElement* old = e[3];
+  pool.destroy(e[3]);
+  EXPECT_EQ(19u, pool.size());
+  e[3] = pal::Quadrupole("QNEW", 0.5).clone(pool);
+  EXPECT_EQ(old, e[3]); // memory reused
+  EXPECT_STREQ("QNEW", e[3]->name.c_str());
+  EXPECT_EQ(20u, pool.size());
+
+  // reference counting: destroyed after last release
+  EXPECT_EQ(1u, pal::AccElementPool::useCount(e[5]));
+  pal::AccElementPool::retain(e[5]);
+  EXPECT_EQ(2u, pal::AccElementPool::useCount(e[5]));
+  pal::AccElementPool::release(e[5]);
+  EXPECT_EQ(20u, pool.size());
+  old = e[5];
+  pal::AccElementPool::release(e[5]);
+  EXPECT_EQ(19u, pool.size());
+  e[5] = pal::Quadrupole("Q5", 0.5).clone(pool);
+  EXPECT_EQ(old, e[5]);
+
+  // disowned pool is deleted after its last element (checked with address sanitizer)
+  pal::AccElementPool* p = new pal::AccElementPool(1024);
+  pal::AccElement* q = pal::Quadrupole("Q", 0.5).clone(*p);
+  p->disown();
+  EXPECT_EQ(p, pal::AccElementPool::poolOf(q));
+  pal::AccElementPool::release(q);
+}
+
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
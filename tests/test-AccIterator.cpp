@@ -62,7 +62,7 @@ TEST_F(AccIteratorTest, TypeIteration) {
 
 TEST_F(AccIteratorTest, PlaneIteration) {
   ++it; ++it;
-  it.element()->plane = pal::V;
+  it.modify()->plane = pal::V;
   it = lattice.begin();
   it.next(pal::dipole, pal::V);
   ASSERT_STREQ("M2", it.element()->name.c_str());
@@ -121,7 +121,7 @@ TEST_F(AccIteratorTest, TypeLoop) {
 
 TEST_F(AccIteratorTest, PlaneLoop) {
   ++it; ++it;
-  it.element()->plane = pal::V;
+  it.modify()->plane = pal::V;
   std::vector<std::string> list;
   // here it is AccTypeIterator<pal::dipole,pal::V>
   for (auto it=lattice.begin<pal::dipole,pal::V>(); it!=lattice.end(); ++it) {
@@ -133,7 +133,7 @@ TEST_F(AccIteratorTest, PlaneLoop) {
 
 
 TEST_F(AccIteratorTest, ModifyElement) {
-  it.element()->name = "NEU";
+  it.modify()->name = "NEU";
   ASSERT_STREQ("NEU", it.element()->name.c_str());
 }
 
@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+#include "../CompiledLattice.hpp"
+
+#include <sstream>
+
+class CompiledLatticeTest : public ::testing::Test {
+public:
+  pal::AccLattice lattice;
+
+  CompiledLatticeTest() : lattice(60., pal::Anchor::center)
+  {
+    double pos = 5.0;
+    std::stringstream name;
+    for(unsigned int num : {1,2,3,5,6,8,9,10,11}) {
+      //dipole
+      name.str(std::string());
+      name << "M" << num;
+      pal::Dipole d(name.str(), 2.5, pal::H, 0.1);
+      d.tilt = 0.001*num;
+      lattice.mount(pos, d);
+      //quadrupole
+      name.str(std::string());
+      if (num%2==0) name << "QF";
+      else name << "QD";
+      name << num;
+      pal::Quadrupole q(name.str(), 0.5, pal::F, 0.42);
+      if (num%2!=0) q.family = pal::D;
+      q.displacement.x = 1e-4*num;
+      lattice.mount(pos+3., q);
+      pos += 5.;
+    }
+    pal::Sextupole s("SX", 0.2, pal::F, 3.1);
+    lattice.mount(pos, s);
+    pal::Corrector c("VC1", 0.1, pal::V, 0.002);
+    c.Qrf1 = 0.3;
+    c.dQrf = 1e-3;
+    lattice.mount(pos+1., c);
+    lattice.mount(pos+2., pal::Cavity("CAV", 0.5)); // no field
+  }
+
+};
+
+TEST_F(CompiledLatticeTest, Snapshot) {
+  pal::CompiledLattice cl(lattice);
+  ASSERT_EQ(lattice.size(), cl.size());
+  EXPECT_EQ(lattice.circumference(), cl.circumference());
+
+  unsigned int i=0;
+  for (auto it=lattice.begin(); it!=lattice.end(); ++it, ++i) {
+    EXPECT_EQ(it.pos(), cl.pos(i));
+    EXPECT_EQ(it.begin(), cl.begin(i));
+    EXPECT_EQ(it.end(), cl.end(i));
+    EXPECT_EQ(it.element()->type, cl.type(i));
+    EXPECT_EQ(it.element()->name, cl.name(i));
+    EXPECT_EQ(it.element()->k0, cl.k0(i));
+    EXPECT_EQ(it.element()->k1, cl.k1(i));
+    EXPECT_EQ(it.element()->displacement, cl.displacement(i));
+    EXPECT_EQ(it.element()->hasField(), cl.hasField(i));
+    for (unsigned int turn : {1, 2, 1000})
+      EXPECT_EQ(it.element()->rfFactor(turn), cl.rfFactor(i,turn));
+  }
+}
+
+TEST_F(CompiledLatticeTest, Lookup) {
+  pal::CompiledLattice cl(lattice);
+  for (double pos=0.; pos<=lattice.circumference(); pos+=0.05) {
+    const pal::AccElement* e = lattice[pos];
+    unsigned int i = cl[pos];
+    if (e->type == pal::drift) {
+      EXPECT_EQ(pal::CompiledLattice::npos, i);
+      EXPECT_THROW(cl.at(pos), pal::AccLattice::noMatchingElement);
+    }
+    else {
+      ASSERT_NE(pal::CompiledLattice::npos, i);
+      EXPECT_EQ(e->name, cl.name(i));
+      EXPECT_EQ(i, cl.at(pos));
+    }
+
+    for (pal::Anchor a : {pal::Anchor::begin, pal::Anchor::center, pal::Anchor::end}) {
+      auto it = lattice.behind(pos, a);
+      unsigned int j = cl.behind(pos, a);
+      if (it == lattice.end())
+	EXPECT_EQ(pal::CompiledLattice::npos, j);
+      else
+	EXPECT_EQ(it.pos(), cl.pos(j));
+    }
+  }
+  EXPECT_THROW(cl[61.], pal::palatticeError);
+}
+
+TEST_F(CompiledLatticeTest, Field) {
+  pal::CompiledLattice cl(lattice);
+  pal::AccPair orbit;
+  orbit.x = 2e-3;
+  orbit.z = -1e-3;
+  // B() is evaluated up to center of last element
+  double last = cl.center(cl.size()-1);
+  for (unsigned int turn=0; turn<3; turn++) {
+    for (double pos=0.; pos<last; pos+=0.01) {
+      double posTot = pos + turn*lattice.circumference();
+      EXPECT_EQ(lattice.B(posTot,orbit), cl.B(posTot,orbit)) << "at " << posTot << " m";
+    }
+  }
+}
+
+
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
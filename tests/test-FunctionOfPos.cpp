@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+#include "../FunctionOfPos.hpp"
+
+#include <thread>
+#include <vector>
+#include <cmath>
+
+TEST(FunctionOfPos, move) {
+  pal::FunctionOfPos<double> f(10., gsl_interp_linear);
+  for (unsigned int i=0; i<10; i++)
+    f.set(0.5*i, i+0.5);
+  f.init();
+  double v = f.interp(4.2);
+
+  // interpolation is still initialized after move (const interp() requires initialization)
+  pal::FunctionOfPos<double> g(std::move(f));
+  const pal::FunctionOfPos<double> &cg = g;
+  EXPECT_EQ(v, cg.interp(4.2));
+  EXPECT_EQ(0u, f.size());
+
+  pal::FunctionOfPos<double> h(10., gsl_interp_linear);
+  h = std::move(g);
+  const pal::FunctionOfPos<double> &ch = h;
+  EXPECT_EQ(v, ch.interp(4.2));
+
+  // copy requires new initialization
+  pal::FunctionOfPos<double> c(10., gsl_interp_linear);
+  c = h;
+  const pal::FunctionOfPos<double> &cc = c;
+  EXPECT_THROW(cc.interp(4.2), pal::palatticeError);
+  EXPECT_EQ(v, c.interp(4.2));
+}
+
+TEST(FunctionOfPos, batch) {
+  pal::FunctionOfPos<double> ref(10., gsl_interp_linear), f(10., gsl_interp_linear);
+  for (double pos : {2.5, 3.5}) {
+    ref.set(-1., pos);
+    f.set(-1., pos);
+  }
+  f.init();
+  {
+    pal::FunctionOfPos<double>::Batch batch(f);
+    pal::FunctionOfPos<double>::Batch inner(f);
+    for (unsigned int obs=0; obs<10; obs++) { // order as trajectory import
+      for (unsigned int t=1; t<=3; t++) {
+	ref.set(obs+0.1*t, obs+0.5, t);
+	f.set(obs+0.1*t, obs+0.5, t);
+      }
+    }
+  }
+  EXPECT_FALSE(f.initialized());
+  EXPECT_EQ(3u, f.turns());
+  ASSERT_EQ(ref.size(), f.size());
+  for (unsigned int i=0; i<f.size(); i++)
+    EXPECT_EQ(ref.get(i), f.get(i));
+  EXPECT_EQ(ref.interp(22.), f.interp(22.));
+
+  std::vector<double> pos = {0.5, 1.5, 2.5}, values = {1., 2., 3.};
+  f.setMany(pos, values, 4);
+  ref.set(1., 0.5, 4);
+  ref.set(2., 1.5, 4);
+  ref.set(3., 2.5, 4);
+  EXPECT_EQ(4u, f.turns());
+  EXPECT_EQ(ref.size(), f.size());
+  EXPECT_EQ(ref.interp(32.), f.interp(32.));
+  values.pop_back();
+  EXPECT_THROW(f.setMany(pos, values), pal::palatticeError);
+  f.reserve(100);
+  EXPECT_EQ(ref.size(), f.size());
+}
+
+TEST(FunctionOfPos, concurrentInterp) {
+  pal::FunctionOfPos<pal::AccPair> orbit(100., gsl_interp_akima);
+  for (unsigned int i=0; i<=1000; i++) {
+    pal::AccPair o;
+    o.x = 1e-3*std::sin(0.05*i);
+    o.z = 1e-3*std::cos(0.03*i);
+    orbit.set(o, 0.1*i);
+  }
+  orbit.init();
+  const pal::FunctionOfPos<pal::AccPair> &cOrbit = orbit;
+  std::vector<double> pos(20000);
+  std::vector<pal::AccPair> ref(pos.size());
+  for (unsigned int i=0; i<pos.size(); i++) {
+    pos[i] = 100. * ((i*7919) % pos.size()) / pos.size(); // not ordered
+    ref[i] = cOrbit.interp(pos[i]);
+  }
+
+  // shared orbit, no copy per thread
+  std::vector<unsigned int> errors(8, 0);
+  std::vector<std::thread> threads;
+  for (unsigned int n=0; n<errors.size(); n++) {
+    threads.push_back(std::thread([&,n]() {
+	  pal::InterpAccel acc;
+	  for (unsigned int repeat=0; repeat<5; repeat++) {
+	    for (unsigned int i=0; i<pos.size(); i++) {
+	      unsigned int k = (n%2==0) ? i : pos.size()-1-i;
+	      pal::AccPair o = (n%4<2) ? cOrbit.interp(pos[k], acc) : cOrbit.interp(pos[k]);
+	      if (!(o == ref[k]))
+		errors[n]++;
+	    }
+	  }
+	}));
+  }
+  for (auto &t : threads)
+    t.join();
+  for (unsigned int n=0; n<errors.size(); n++)
+    EXPECT_EQ(0u, errors[n]) << "thread " << n;
+}
+
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,39 @@
+#include "gtest/gtest.h"
+#include "../NameMatcher.hpp"
+#include "../AccElements.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+TEST(NameMatcher, match) {
+  std::vector<std::string> patterns = {"QF1", "Q*F", "M*", "*X", "SX*X", "K*M*", "*", "AB*BA", ""};
+  std::vector<std::string> names = {"QF1", "QF", "QFF", "QD1F", "QD", "M1", "M", "XM", "SXX", "SXAX", "SX", "K*MX", "KM", "ABA", "ABBA", "ABXBA", "", "qf1"};
+  for (auto &p : patterns) {
+    pal::NameMatcher m;
+    m.add(p);
+    for (auto &n : names) {
+      pal::Marker e(n);
+      EXPECT_EQ(e.nameMatch(p), m.match(n)) << "pattern " << p << ", name " << n;
+    }
+  }
+
+  patterns.pop_back(); // "*" matches everything
+  patterns.erase(std::find(patterns.begin(), patterns.end(), "*"));
+  pal::NameMatcher m(patterns);
+  EXPECT_EQ(patterns.size(), m.size());
+  for (auto &n : names) {
+    pal::Marker e(n);
+    EXPECT_EQ(e.nameMatch(patterns), m.match(n)) << "name " << n;
+  }
+  EXPECT_TRUE(m.match("QFF"));
+  EXPECT_TRUE(m.match("ABBA"));
+  EXPECT_FALSE(m.match("ABA"));
+  EXPECT_FALSE(m.match("QD"));
+}
+
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,50 @@
+#include "gtest/gtest.h"
+#include "../SortedData.hpp"
+#include "../FunctionOfPos.hpp"
+
+#include <map>
+
+TEST(SortedData, mapInterface) {
+  std::map<double,double> ref;
+  pal::SortedData<double> d;
+  for (double x : {3., 1., 4., 1., 5., 9., 2., 6.}) {
+    auto r = ref.insert(std::make_pair(x, 10*x));
+    auto s = d.insert(std::make_pair(x, 10*x));
+    EXPECT_EQ(r.second, s.second);
+    EXPECT_EQ(r.first->first, s.first->first);
+  }
+  for (double x=0.; x<20.; x+=1.) // append
+    d[x+10.5] = ref[x+10.5] = x;
+  ASSERT_EQ(ref.size(), d.size());
+  EXPECT_TRUE((ref == std::map<double,double>(d)));
+  EXPECT_EQ(ref.rbegin()->first, d.rbegin()->first);
+  for (double x : {0., 1., 1.5, 9., 30., 40.}) {
+    EXPECT_EQ(ref.count(x), d.count(x));
+    EXPECT_EQ(std::distance(ref.begin(),ref.lower_bound(x)), d.lower_bound(x)-d.begin());
+    EXPECT_EQ(std::distance(ref.begin(),ref.upper_bound(x)), d.upper_bound(x)-d.begin());
+  }
+  for (auto e : d)
+    e.second *= 2;
+  EXPECT_EQ(60., d.find(3.)->second);
+  d.erase(d.lower_bound(5.), d.end());
+  EXPECT_EQ(4u, d.size());
+  EXPECT_EQ(4., d.rbegin()->first);
+
+  // spline is initialized from arrays, also periodic
+  pal::FunctionOfPos<pal::AccPair> f(10., gsl_interp_akima_periodic);
+  for (unsigned int i=0; i<10; i++) {
+    pal::AccPair p;
+    p.x = i;
+    p.z = -1.*i;
+    f.set(p, i);
+  }
+  EXPECT_DOUBLE_EQ(4.5, f.interp(4.5).x);
+  EXPECT_DOUBLE_EQ(-4.5, f.interp(4.5).z);
+  EXPECT_DOUBLE_EQ(4.5, f.interp(9.5).x); // between 9 and 10 (=0)
+}
+
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
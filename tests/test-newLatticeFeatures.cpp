@@ -1,7 +1,11 @@
 #include "gtest/gtest.h"
 #include "../AccLattice.hpp"
+#include "../FunctionOfPos.hpp"
+#include "../Field.hpp"
 
 #include <sstream>
+#include <thread>
+#include <type_traits>
 
 class AccLatticeTest : public ::testing::Test {
 public:
@@ -55,6 +59,981 @@ TEST_F(AccLatticeTest, bentLength) {
 }
 
 
+TEST_F(AccLatticeTest, positionIndex) {
+  pal::AccLattice ref(lattice);
+  ref.usePositionIndex(false);
+  lattice.dismount(lattice["QF6"]);
+  ref.dismount(ref["QF6"]);
+  pal::Corrector c("C1", 0.1);
+  lattice.mount(56.7, c);
+  ref.mount(56.7, c);
+
+  for (double pos=0.; pos<=lattice.circumference(); pos+=0.01) {
+    EXPECT_EQ(ref[pos]->name, lattice[pos]->name) << "at " << pos << " m";
+    for (pal::Anchor a : {pal::Anchor::begin, pal::Anchor::center, pal::Anchor::end}) {
+      auto it = lattice.behind(pos, a);
+      auto itRef = ref.behind(pos, a);
+      if (itRef == ref.end())
+	EXPECT_TRUE(it == lattice.end());
+      else
+	EXPECT_EQ(itRef.pos(), it.pos());
+    }
+  }
+  EXPECT_STREQ("C1", lattice[56.7]->name.c_str());
+  EXPECT_EQ(pal::drift, lattice[22.7]->type);
+}
+
+TEST_F(AccLatticeTest, find) {
+  const pal::AccLattice &cLattice = lattice;
+  for (double pos=0.; pos<=lattice.circumference(); pos+=0.01) {
+    auto it = cLattice.find(pos);
+    if (it == cLattice.end()) {
+      EXPECT_THROW(cLattice.at(pos), pal::AccLattice::noMatchingElement);
+      EXPECT_EQ(pal::drift, lattice[pos]->type);
+    }
+    else {
+      EXPECT_TRUE(it == cLattice.at(pos));
+      EXPECT_EQ(it.element(), lattice[pos]);
+    }
+  }
+  EXPECT_STREQ("QD3", lattice.find(18.2).element()->name.c_str());
+  EXPECT_TRUE(lattice.find(22.7) == lattice.end());
+  EXPECT_STREQ("QD3", lattice.findBehind(16., pal::Anchor::begin).element()->name.c_str());
+  EXPECT_STREQ("M5", lattice.findBehind(18.2, pal::Anchor::begin).element()->name.c_str());
+  EXPECT_TRUE(lattice.findBehind(50.1, pal::Anchor::begin) == lattice.end());
+}
+
+TEST_F(AccLatticeTest, fieldSet) {
+  lattice.mount(59.95, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::FunctionOfPos<pal::AccPair> orbit(lattice.circumference(), gsl_interp_linear);
+  for (unsigned int t=1; t<=2; t++) {
+    for (unsigned int i=0; i<300; i++) {
+      double pos = i*0.2;
+      pal::AccPair o;
+      o.x = 1e-3*std::sin(pos+t);
+      o.z = 1e-3*std::cos(pos);
+      orbit.set(o, pos, t);
+    }
+  }
+  pal::Field field(lattice.circumference());
+  field.set(lattice, orbit, 600);
+  ASSERT_EQ(1200u, field.size());
+  for (unsigned int t=1; t<=2; t++) {
+    for (unsigned int i=0; i<600; i++) {
+      double pos = i*0.1;
+      double posTot = orbit.posTotal(pos, t);
+      if (posTot > orbit.interpMax()) // no orbit: orbit of previous sample is used
+	continue;
+      pal::AccTriple ref = lattice.B(posTot, orbit.interp(posTot));
+      pal::AccTriple b = field.get((t-1)*600+i);
+      EXPECT_EQ(ref.x, b.x) << "at " << posTot << " m";
+      EXPECT_EQ(ref.z, b.z) << "at " << posTot << " m";
+    }
+  }
+
+  // no orbit: field without orbit
+  pal::FunctionOfPos<pal::AccPair> noOrbit(lattice.circumference());
+  pal::Field field2(lattice.circumference());
+  field2.set(lattice, noOrbit, 600);
+  EXPECT_EQ(600u, field2.size());
+  EXPECT_EQ(lattice.B(10.,pal::AccPair()).z, field2.get(100).z);
+}
+
+class FieldData : public pal::Field {
+public:
+  FieldData(double circ) : pal::Field(circ) {}
+  const pal::SortedData<pal::AccTriple>& getData() const {return data;}
+};
+
+TEST_F(AccLatticeTest, fieldSetThreads) {
+  lattice.mount(59.95, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::Corrector c("RF", 0.2, pal::V, 1e-3);
+  c.Qrf1 = 0.17;
+  lattice.mount(1., c);
+  // orbit starts after first sample and ends in turn 5 -> extrapolation
+  pal::FunctionOfPos<pal::AccPair> orbit(lattice.circumference(), gsl_interp_linear);
+  for (unsigned int t=1; t<=5; t++) {
+    for (unsigned int i=0; i<300; i++) {
+      double pos = 0.05 + i*0.2;
+      if (t==5 && pos > 20.) break;
+      pal::AccPair o;
+      o.x = 1e-3*std::sin(pos+t);
+      o.z = 1e-3*std::cos(pos);
+      orbit.set(o, pos, t);
+    }
+  }
+
+  for (bool edgefields : {true, false}) {
+    FieldData serial(lattice.circumference());
+    serial.set(lattice, orbit, 600, edgefields, 1);
+    ASSERT_EQ(3000u, serial.size());
+    for (unsigned int n : {0, 2, 3, 7, 16}) {
+      FieldData parallel(lattice.circumference());
+      parallel.set(lattice, orbit, 600, edgefields, n);
+      ASSERT_EQ(serial.size(), parallel.size());
+      auto it = parallel.getData().begin();
+      for (const auto &ref : serial.getData()) {
+	EXPECT_EQ(ref.first, it->first);
+	EXPECT_EQ(ref.second.x, it->second.x) << n << " threads at " << ref.first << " m";
+	EXPECT_EQ(ref.second.z, it->second.z) << n << " threads at " << ref.first << " m";
+	EXPECT_EQ(ref.second.s, it->second.s) << n << " threads at " << ref.first << " m";
+	++it;
+      }
+    }
+  }
+}
+
+// elements of lattice copies are shared, Field::set() must not modify them
+TEST_F(AccLatticeTest, fieldSetLatticeCopies) {
+  lattice.mount(59.95, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::Corrector c("RF", 0.2, pal::V, 1e-3);
+  c.Qrf1 = 0.17;
+  lattice.mount(1., c);
+  pal::FunctionOfPos<pal::AccPair> noOrbit(lattice.circumference());
+  FieldData ref(lattice.circumference());
+  ref.set(lattice, noOrbit, 600);
+
+  std::vector<FieldData> fields(4, FieldData(lattice.circumference()));
+  std::vector<pal::FunctionOfPos<pal::AccPair>> orbits(fields.size(), noOrbit);
+  for (unsigned int n=0; n<fields.size(); n++) {
+    for (unsigned int t=1; t<=n+1; t++) // different number of turns in each thread
+      orbits[n].set(pal::AccPair(), 0., t);
+  }
+  std::vector<std::thread> threads;
+  for (unsigned int n=0; n<fields.size(); n++) {
+    threads.push_back(std::thread([&,n]() {
+	  pal::AccLattice copy(lattice);
+	  fields[n].set(copy, orbits[n], 600);
+	}));
+  }
+  for (auto &t : threads)
+    t.join();
+  for (unsigned int n=0; n<fields.size(); n++) {
+    ASSERT_EQ(600*(n+1), fields[n].size());
+    auto f = fields[n].getData().begin();
+    for (const auto &r : ref.getData()) {
+      EXPECT_EQ(r.second, f->second) << "thread " << n << " at " << r.first << " m";
+      ++f;
+    }
+  }
+}
+
+TEST_F(AccLatticeTest, fieldUpdate) {
+  lattice.mount(59.95, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::Corrector c("RF", 0.2, pal::V, 1e-3);
+  c.Qrf1 = 0.17;
+  lattice.mount(1., c);
+  pal::FunctionOfPos<pal::AccPair> orbit(lattice.circumference(), gsl_interp_linear);
+  for (unsigned int t=1; t<=3; t++) {
+    for (unsigned int i=0; i<300; i++) {
+      pal::AccPair o;
+      o.x = 1e-3*std::sin(i*0.2+t);
+      o.z = 1e-3*std::cos(i*0.2);
+      orbit.set(o, i*0.2, t);
+    }
+  }
+
+  for (bool edgefields : {true, false}) {
+    FieldData field(lattice.circumference());
+    field.set(lattice, orbit, 600, edgefields);
+    for (std::string name : {"QF2", "RF", "M1", "QDX"}) {
+      auto it = lattice[name];
+      it.modify()->k1 += 0.1;
+      it.modify()->k0.x += 1e-3;
+      field.update(lattice, orbit, it);
+
+      FieldData ref(lattice.circumference());
+      ref.set(lattice, orbit, 600, edgefields);
+      ASSERT_EQ(ref.size(), field.size());
+      auto f = field.getData().begin();
+      for (const auto &r : ref.getData()) {
+	EXPECT_EQ(r.first, f->first);
+	EXPECT_EQ(r.second, f->second) << name << " changed, at " << r.first << " m";
+	++f;
+      }
+    }
+  }
+  // orbit extrapolation (after 59.8 m in last turn) is reported only if updated samples are affected
+  FieldData field(lattice.circumference());
+  testing::internal::CaptureStdout();
+  field.set(lattice, orbit, 600);
+  EXPECT_NE(std::string::npos, testing::internal::GetCapturedStdout().find("extrapolation"));
+  testing::internal::CaptureStdout();
+  field.update(lattice, orbit, lattice["QF2"]);
+  EXPECT_EQ(std::string::npos, testing::internal::GetCapturedStdout().find("extrapolation"));
+  testing::internal::CaptureStdout();
+  field.update(lattice, orbit, lattice["END"]);
+  EXPECT_NE(std::string::npos, testing::internal::GetCapturedStdout().find("extrapolation"));
+}
+
+TEST_F(AccLatticeTest, fieldAdaptive) {
+  lattice.mount(59.999, pal::Marker("END")); // B() is evaluated up to center of last element
+  for (auto it=lattice.begin<pal::dipole>(); it!=lattice.end(); ++it)
+    it.modify()->k0.z = 0.1;
+  pal::FunctionOfPos<pal::AccPair> orbit(lattice.circumference(), gsl_interp_linear);
+  for (unsigned int t=1; t<=2; t++) {
+    for (unsigned int i=0; i<300; i++) {
+      pal::AccPair o;
+      o.x = 1e-3*std::sin(i*0.2+t);
+      o.z = 1e-3*std::cos(i*0.2);
+      orbit.set(o, i*0.2, t);
+    }
+  }
+  EXPECT_THROW(pal::Field(60.).setAdaptive(lattice, orbit, 0.), pal::palatticeError);
+
+  double accuracy = 1e-4;
+  pal::Field field(lattice.circumference()); // default interpolation type is used for uniform samples only
+  field.setAdaptive(lattice, orbit, accuracy);
+  EXPECT_TRUE(field.isAdaptive());
+  EXPECT_EQ(2u, field.turns());
+  double sigma = lattice["M1"].element()->edgeSigma();
+  EXPECT_LT(field.size()/2, lattice.circumference() / (sigma*std::sqrt(8*accuracy)) / 5); // uniform sampling with same accuracy
+
+  for (unsigned int i=0; i<59000; i++) {
+    double pos = i*0.001;
+    pal::AccTriple ref = lattice.B(pos, orbit.interp(pos));
+    pal::AccTriple b = field.interp(pos);
+    EXPECT_NEAR(ref.x, b.x, 0.1*accuracy + 1e-6) << "at " << pos << " m";
+    EXPECT_NEAR(ref.z, b.z, 0.1*accuracy + 1e-6) << "at " << pos << " m";
+  }
+  EXPECT_STREQ("linear", field.getType());
+
+  for (bool edgefields : {true, false}) {
+    FieldData adaptive(lattice.circumference());
+    adaptive.setAdaptive(lattice, orbit, accuracy, 0.1, edgefields);
+    auto it = lattice["QF2"];
+    it.modify()->k1 += 0.1;
+    adaptive.update(lattice, orbit, it);
+    FieldData ref(lattice.circumference());
+    ref.setAdaptive(lattice, orbit, accuracy, 0.1, edgefields);
+    ASSERT_EQ(ref.size(), adaptive.size());
+    auto f = adaptive.getData().begin();
+    for (const auto &r : ref.getData()) {
+      EXPECT_EQ(r.first, f->first);
+      EXPECT_EQ(r.second, f->second) << "at " << r.first << " m";
+      ++f;
+    }
+  }
+
+  // spectrum of adaptive samples is close to the one of dense uniform samples
+  pal::Field dense(lattice.circumference());
+  dense.set(lattice, orbit, 30000);
+  for (pal::AccAxis axis : {pal::x, pal::z}) {
+    pal::Spectrum ref = dense.getSpectrum(axis, 20);
+    pal::Spectrum spec = field.getSpectrum(axis, 20);
+    ASSERT_EQ(41u, spec.size()); // 2 turns
+    ASSERT_EQ(ref.size(), spec.size());
+    for (unsigned int k=0; k<spec.size(); k++) {
+      EXPECT_DOUBLE_EQ(ref.freq(k), spec.freq(k));
+      EXPECT_NEAR(ref.amp(k), spec.amp(k), 1e-5) << "axis " << axis << ", harmonic " << k;
+      if (spec.amp(k) > 1e-3) { // phase deviation ~ amplitude deviation / amplitude
+	EXPECT_NEAR(ref.phase(k), spec.phase(k), 1e-5/spec.amp(k)) << "axis " << axis << ", harmonic " << k;
+      }
+    }
+  }
+
+  field.resample(600);
+  EXPECT_FALSE(field.isAdaptive());
+  EXPECT_EQ(1200u, field.size());
+  EXPECT_EQ(2u, field.turns());
+  field.interp(1.);
+  EXPECT_STREQ("akima", field.getType());
+}
+
+// set() and setAdaptive() replace all samples of the previous sampling
+TEST_F(AccLatticeTest, fieldSwitchSampling) {
+  lattice.mount(59.999, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::FunctionOfPos<pal::AccPair> orbit(lattice.circumference(), gsl_interp_linear);
+  for (unsigned int t=1; t<=2; t++) {
+    for (unsigned int i=0; i<300; i++) {
+      pal::AccPair o;
+      o.x = 1e-3*std::sin(i*0.2+t);
+      orbit.set(o, i*0.2, t);
+    }
+  }
+  FieldData uniform(lattice.circumference()), adaptive(lattice.circumference());
+  uniform.set(lattice, orbit, 600);
+  adaptive.setAdaptive(lattice, orbit);
+
+  auto expectEqual = [](const FieldData &ref, const FieldData &f) {
+    ASSERT_EQ(ref.size(), f.size());
+    EXPECT_EQ(ref.turns(), f.turns());
+    auto it = f.getData().begin();
+    for (const auto &r : ref.getData()) {
+      EXPECT_EQ(r.first, it->first);
+      EXPECT_EQ(r.second, it->second) << "at " << r.first << " m";
+      ++it;
+    }
+  };
+  FieldData field(lattice.circumference());
+  field.set(lattice, orbit, 600);
+  field.setAdaptive(lattice, orbit);
+  expectEqual(adaptive, field);
+  field.set(lattice, orbit, 600);
+  expectEqual(uniform, field);
+  field.set(lattice, orbit, 500);
+  EXPECT_EQ(1000u, field.size());
+
+  // orbit with less turns
+  pal::FunctionOfPos<pal::AccPair> orbit1(lattice.circumference(), gsl_interp_linear);
+  for (unsigned int i=0; i<300; i++)
+    orbit1.set(orbit.get(i), i*0.2);
+  field.set(lattice, orbit1, 500);
+  EXPECT_EQ(1u, field.turns());
+  EXPECT_EQ(500u, field.size());
+}
+
+TEST_F(AccLatticeTest, fieldSpectrum) {
+  lattice.mount(59.999, pal::Marker("END")); // B() is evaluated up to center of last element
+  for (auto it=lattice.begin<pal::dipole>(); it!=lattice.end(); ++it)
+    it.modify()->k0.z = 0.1;
+  pal::FunctionOfPos<pal::AccPair> orbit(lattice.circumference(), gsl_interp_linear);
+  pal::AccPair o;
+  o.x = 1e-3;
+  o.z = -5e-4;
+  orbit.set(o, 0.);
+  orbit.set(o, 59.9);
+
+  for (bool edgefields : {true, false}) {
+    pal::Field field(lattice.circumference());
+    field.set(lattice, orbit, 6000, edgefields);
+    for (pal::AccAxis axis : {pal::x, pal::z}) {
+      pal::Spectrum ref = field.getSpectrum(axis, 20);
+      pal::Spectrum spec = lattice.fieldSpectrum(orbit, 20, axis, 0., edgefields);
+      ASSERT_EQ(ref.size(), spec.size());
+      for (unsigned int k=0; k<spec.size(); k++) {
+	EXPECT_DOUBLE_EQ(ref.freq(k), spec.freq(k));
+	// sampling error of field: hard edges ~ sample interval/element length
+	EXPECT_NEAR(ref.amp(k), spec.amp(k), edgefields ? 1e-7 : 2e-4) << "axis " << axis << ", harmonic " << k;
+	if (spec.amp(k) > 1e-3) {
+	  EXPECT_NEAR(ref.phase(k), spec.phase(k), 1e-3) << "axis " << axis << ", harmonic " << k;
+	}
+      }
+    }
+  }
+}
+
+TEST_F(AccLatticeTest, fieldSeparable) {
+  lattice.mount(59.95, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::Corrector c("RF1", 0.2, pal::V, 1e-3);
+  c.Qrf1 = 0.17;
+  lattice.mount(1., c);
+  c.name = "RF2";
+  c.dQrf = 1e-3;
+  lattice.mount(7.6, c); // edge fields overlap with M1 and QF2
+  pal::FunctionOfPos<pal::AccPair> orbit(lattice.circumference(), gsl_interp_linear);
+  for (unsigned int i=0; i<300; i++) {
+    pal::AccPair o;
+    o.x = 1e-3*std::sin(i*0.2);
+    o.z = 1e-3*std::cos(i*0.2);
+    orbit.set(o, i*0.2);
+  }
+
+  // no field data to reach via FunctionOfPos base class
+  EXPECT_FALSE((std::is_base_of<pal::FunctionOfPos<pal::AccTriple>, pal::SeparableField>::value));
+
+  for (bool edgefields : {true, false}) {
+    pal::SeparableField sep(lattice.circumference());
+    sep.set(lattice, orbit, 600, 4, edgefields);
+    EXPECT_EQ(4u, sep.turns());
+    EXPECT_EQ(2400u, sep.size());
+    EXPECT_EQ(600u, sep.samplesInTurn());
+
+    // turn 1 equals set()
+    FieldData ref(lattice.circumference());
+    ref.set(lattice, orbit, 600, edgefields);
+    unsigned int i=0;
+    for (const auto &r : ref.getData()) {
+      EXPECT_EQ(r.second, sep.B(i,1)) << "at " << r.first << " m";
+      i++;
+    }
+    // other turns: orbit of turn 1 (set() differs by rounding of posTotal())
+    for (unsigned int t=2; t<=4; t++) {
+      for (i=0; i<599; i++) { // no orbit at last sample
+	double pos = i*0.1;
+	pal::AccTriple b;
+	if (edgefields)
+	  b = lattice.B(ref.posTotal(pos,t), orbit.interp(pos));
+	else
+	  b = lattice[pos]->B_rf(t, orbit.interp(pos));
+	pal::AccTriple bs = sep.B(i,t);
+	EXPECT_NEAR(b.x, bs.x, 1e-15) << "turn " << t << " at " << pos << " m";
+	EXPECT_NEAR(b.z, bs.z, 1e-15) << "turn " << t << " at " << pos << " m";
+      }
+    }
+    EXPECT_THROW(sep.B(600,1), pal::palatticeError);
+    EXPECT_THROW(sep.B(0,5), pal::palatticeError);
+
+    pal::Spectrum spec = sep.getSpectrum(pal::z, 30);
+    pal::Field full = sep.expand();
+    ASSERT_EQ(2400u, full.size());
+    EXPECT_EQ(4u, full.turns());
+    for (unsigned int k=0; k<full.size(); k++)
+      EXPECT_EQ(sep.B(k%600, k/600+1), full.get(k)) << "sample " << k;
+    // expanded field through base class (e.g. FunctionOfPos::operator+=)
+    full.init();
+    const pal::FunctionOfPos<pal::AccTriple> &base = full;
+    EXPECT_EQ(sep.B(35,3), base.interp(base.posTotal(3.5,3)));
+    pal::FunctionOfPos<pal::AccTriple> sum(full);
+    sum += base;
+    EXPECT_DOUBLE_EQ(2*sep.B(35,3).z, sum.get(2*600+35).z);
+    pal::Spectrum specFull = full.getSpectrum(pal::z, 30);
+    ASSERT_EQ(specFull.size(), spec.size());
+    for (unsigned int k=0; k<spec.size(); k++)
+      EXPECT_EQ(specFull.amp(k), spec.amp(k));
+  }
+}
+
+TEST_F(AccLatticeTest, batchB) {
+  lattice.mount(59.95, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::Corrector c("RF", 0.2, pal::V, 1e-3);
+  c.Qrf1 = 0.17;
+  lattice.mount(7.6, c);
+  std::vector<double> pos, x, z;
+  for (unsigned int i=0; i<1200; i++) { // 2 turns
+    pos.push_back(i*0.1);
+    x.push_back(1e-3*std::sin(i*0.01));
+    z.push_back(-1e-3*std::cos(i*0.02));
+  }
+  std::vector<pal::AccTriple> out(pos.size());
+  lattice.B(pos.data(), x.data(), z.data(), pos.size(), out.data());
+  for (unsigned int i=0; i<pos.size(); i++) {
+    pal::AccPair o;
+    o.x = x[i];
+    o.z = z[i];
+    EXPECT_EQ(lattice.B(pos[i],o), out[i]) << "at " << pos[i] << " m";
+  }
+}
+
+TEST_F(AccLatticeTest, slopeTable) {
+  for (double u=0.; u<10.; u+=0.001)
+    EXPECT_NEAR(std::exp(-0.5*u*u), pal::AccLattice::gaussSlope(u), EDGEFIELD_SLOPE_TOLERANCE) << "u=" << u;
+  EXPECT_EQ(0., pal::AccLattice::gaussSlope(-INFINITY));
+
+  // edge fields of dipole M1 and quadrupole QF2 (5m - 8.5m)
+  for (auto it=lattice.begin(); it!=lattice.end() && it.pos()<9.; ++it) {
+    double dl = it.element()->dl()/2;
+    double sigma = dl * std::sqrt(2./M_PI);
+    for (double pos=4.; pos<9.; pos+=0.001) {
+      double x = 0.;
+      double distBegin = it.distanceRing(pal::Anchor::begin,pos) - dl;
+      double distEnd = it.distanceRing(pal::Anchor::end,pos) + dl;
+      if (distBegin < 0) x = distBegin;
+      else if (distEnd > 0) x = distEnd;
+      EXPECT_NEAR(std::exp(-0.5*std::pow(x/sigma,2)), lattice.slope(pos,it), EDGEFIELD_SLOPE_TOLERANCE) << it.element()->name << " at " << pos << " m";
+    }
+  }
+}
+
+TEST(Magnet, batchB) {
+  pal::Quadrupole q("QD", 0.5, pal::D, 0.42);
+  q.tilt = 0.003;
+  q.displacement.x = 2e-4;
+  q.displacement.z = -1e-4;
+  pal::Sextupole sx("SX", 0.2, pal::F, 3.1);
+  sx.tilt = -0.01;
+  pal::Dipole d("M", 2.5, pal::H, 0.1);
+  d.tilt = 0.001;
+  pal::Drift dr("D", 1.0);
+  std::vector<double> x, z;
+  for (unsigned int i=0; i<100; i++) {
+    x.push_back(1e-3*std::sin(i*0.1));
+    z.push_back(1e-3*std::cos(i*0.3));
+  }
+  std::vector<pal::AccTriple> out(x.size());
+  for (const pal::AccElement *e : std::vector<const pal::AccElement*>{&q, &sx, &d, &dr}) {
+    e->B(x.data(), z.data(), x.size(), out.data());
+    for (unsigned int i=0; i<x.size(); i++) {
+      pal::AccPair o;
+      o.x = x[i];
+      o.z = z[i];
+      EXPECT_EQ(e->B(o), out[i]) << e->name << " " << i;
+    }
+  }
+}
+
+TEST(ElementField, B) {
+  pal::Quadrupole q("QD", 0.5, pal::D, 0.42);
+  q.displacement.x = 2e-4;
+  pal::Sextupole sx("SX", 0.2, pal::F, 3.1);
+  sx.tilt = -0.01;
+  pal::Corrector c("VC", 0.1, pal::V, 2e-3);
+  c.family = pal::D;
+  pal::Solenoid so("SO", 1.0, 0.3);
+  pal::Multipole mp("MP", 0.1);
+  mp.k1 = 0.1;
+  pal::Drift dr("D", 1.0);
+  pal::Marker m("M");
+  pal::Monitor bpm("BPM", 0.);
+  pal::Cavity cav("CAV", 1.);
+  pal::AccPair o;
+  o.x = 1.5e-3;
+  o.z = -0.7e-3;
+  for (const pal::AccElement *e : std::vector<const pal::AccElement*>{&q, &sx, &c, &so, &mp, &dr, &m, &bpm, &cav}) {
+    EXPECT_EQ(e->type!=pal::drift && e->type!=pal::marker && e->type!=pal::monitor && e->type!=pal::cavity, e->hasField()) << e->name;
+    EXPECT_EQ(e->B(o), e->field().B(o)) << e->name;
+  }
+}
+
+TEST(AccElement, rfFactorTable) {
+  pal::Corrector c("RF", 0.1, pal::V, 1e-3);
+  c.Qrf1 = 0.17;
+  c.dQrf = 1e-5;
+  c.rfPeriod = 300;
+  std::vector<double> ref;
+  for (unsigned int t=1; t<=1000; t++)
+    ref.push_back(c.rfFactor(t));
+
+  pal::RfFactorTable table(100, 500);
+  table.add(&c);
+  EXPECT_EQ(1u, table.size());
+  for (unsigned int t=1; t<=1000; t++)
+    EXPECT_EQ(ref[t-1], table(&c,t)) << "turn " << t;
+
+  // elements without table entry and non-RF elements use rfFactor()
+  pal::Corrector c2("RF2", 0.1, pal::V, 1e-3);
+  c2.Qrf1 = 0.23;
+  for (unsigned int t=100; t<=500; t++)
+    EXPECT_EQ(c2.rfFactor(t), table(&c2,t)) << "turn " << t;
+  pal::Dipole d("D", 1.);
+  table.add(&d);
+  EXPECT_EQ(1u, table.size());
+  EXPECT_EQ(1., table(&d,200));
+}
+
+TEST_F(AccLatticeTest, cursor) {
+  lattice.mount(59.95, pal::Marker("END")); // B() is evaluated up to center of last element
+  pal::AccPair orbit;
+  orbit.x = 1e-3;
+  orbit.z = -2e-3;
+  pal::LatticeCursor cursor(lattice);
+  // increasing positions over 2 turns
+  for (unsigned int i=0; i<1200; i++) {
+    double pos = i*0.1;
+    cursor.moveTo(pos);
+    EXPECT_EQ(lattice.turn(pos), cursor.turn());
+    EXPECT_TRUE(cursor.next() == lattice.findBehind(lattice.posMod(pos), pal::Anchor::center)) << "at " << pos << " m";
+    pal::AccTriple ref = lattice.B(pos, orbit);
+    pal::AccTriple b = lattice.B(cursor, orbit);
+    EXPECT_EQ(ref.x, b.x) << "at " << pos << " m";
+    EXPECT_EQ(ref.z, b.z) << "at " << pos << " m";
+  }
+  // backwards and on element borders
+  for (double pos : {30., 5., 5., 6.25, 7.5, 8., 8.25, 8.5, 3.})  {
+    cursor.moveTo(pos);
+    EXPECT_TRUE(cursor.next() == lattice.findBehind(pos, pal::Anchor::center)) << "at " << pos << " m";
+  }
+}
+
+TEST_F(AccLatticeTest, nameIndex) {
+  EXPECT_EQ(18., lattice["QD3"].pos());
+  EXPECT_THROW(lattice["XY"], pal::AccLattice::noMatchingElement);
+
+  // ambiguous name: first match in lattice
+  pal::Corrector c("QD3", 0.1);
+  lattice.mount(57.0, c);
+  lattice.mount(1.0, c);
+  EXPECT_EQ(1., lattice["QD3"].pos());
+  lattice.dismount(1.0);
+  EXPECT_EQ(18., lattice["QD3"].pos());
+  lattice.dismount(lattice["QD3"]);
+  EXPECT_EQ(57., lattice["QD3"].pos());
+
+  // renamed via pointer
+  lattice["M5"].modify()->name = "XY";
+  EXPECT_EQ(20., lattice["XY"].pos());
+  EXPECT_THROW(lattice["M5"], pal::AccLattice::noMatchingElement);
+  lattice["QF8"].modify()->name = "XY";
+  EXPECT_EQ(20., lattice["XY"].pos());
+  // lower element renamed to existing name -> new first match
+  double pos = lattice["QF2"].pos();
+  ASSERT_LT(pos, 20.);
+  lattice["QF2"].modify()->name = "XY";
+  EXPECT_EQ(pos, lattice["XY"].pos());
+  for (auto it=lattice.begin(); it!=lattice.end(); ++it) {
+    if ((*it)->name == "XY")
+      it.modify()->name = "YZ";
+  }
+  EXPECT_THROW(lattice["XY"], pal::AccLattice::noMatchingElement);
+  EXPECT_EQ(pos, lattice["YZ"].pos());
+  lattice.dismount(pos);
+  EXPECT_EQ(20., lattice["YZ"].pos());
+
+  const pal::AccLattice& cl = lattice;
+  EXPECT_EQ(57., cl["QD3"].pos());
+}
+
+TEST_F(AccLatticeTest, typeIndex) {
+  lattice.setFamily(pal::D, "QD*");
+  pal::Corrector c("C1", 0.1, pal::V);
+  lattice.mount(1.0, c);
+  lattice.mount(57.0, c);
+  lattice["M6"].modify()->plane = pal::V;
+
+  std::vector<std::string> names;
+  for (auto it=lattice.begin<pal::quadrupole,pal::noplane,pal::D>(); it!=lattice.end(); ++it)
+    names.push_back(it.element()->name);
+  EXPECT_EQ(std::vector<std::string>({"QD1","QD3","QD5","QD9","QD11"}), names);
+  EXPECT_EQ(5u, lattice.size(pal::quadrupole, pal::noplane, pal::D));
+  EXPECT_EQ(2u, lattice.size(pal::corrector));
+
+  auto it = lattice.begin(pal::dipole, pal::V);
+  EXPECT_STREQ("M6", it.element()->name.c_str());
+  it.next(pal::dipole, pal::V);
+  EXPECT_TRUE(it == lattice.end());
+
+  // start at other type, iterate both directions
+  it = lattice["QF6"];
+  it.next(pal::corrector);
+  EXPECT_STREQ("C1", it.element()->name.c_str());
+  EXPECT_EQ(57., it.pos());
+  it.prev(pal::dipole);
+  EXPECT_STREQ("M11", it.element()->name.c_str());
+  it.prev(pal::corrector);
+  EXPECT_EQ(1., it.pos());
+  it.prev(pal::corrector);
+  EXPECT_TRUE(it == lattice.begin());
+
+  // index updated after dismount
+  lattice.dismount(57.0);
+  it = lattice["QF6"];
+  it.next(pal::corrector);
+  EXPECT_TRUE(it == lattice.end());
+  EXPECT_EQ(1u, lattice.size(pal::corrector));
+}
+
+TEST_F(AccLatticeTest, theta) {
+  double R = 10.;
+  for (auto it=lattice.begin<pal::dipole>(); it!=lattice.end(); ++it) {
+    static_cast<pal::Dipole*>(it.modify())->setR(R);
+    R += 1.;
+  }
+  std::vector<double> pos;
+  for (double p=0.; p<lattice.circumference(); p+=0.03)
+    pos.push_back(p);
+  std::vector<double> theta = lattice.theta(pos);
+
+  for (unsigned int i=0; i<pos.size(); i++) {
+    double expected = 0.;
+    for (auto it=lattice.begin<pal::dipole>(); it!=lattice.end(); ++it) {
+      if (it.end() < pos[i]) expected += it.element()->length * it.element()->k0.z;
+      else if (it.begin() <= pos[i]) expected += (pos[i]-it.begin()) * it.element()->k0.z;
+    }
+    EXPECT_DOUBLE_EQ(expected, lattice.theta(pos[i])) << "at " << pos[i] << " m";
+    EXPECT_EQ(lattice.theta(pos[i]), theta[i]);
+  }
+  double total = lattice.theta(lattice.circumference());
+
+  // change of strength via iterator
+  lattice["M1"].modify()->k0.z = 0.;
+  EXPECT_DOUBLE_EQ(total - 2.5/10., lattice.theta(lattice.circumference()));
+  lattice.dismount(lattice["M2"]);
+  EXPECT_DOUBLE_EQ(total - 2.5/10. - 2.5/11., lattice.theta(lattice.circumference()));
+
+  // change via kept pointer: modified() required
+  total = lattice.theta(lattice.circumference());
+  pal::AccElement* m3 = lattice["M3"].modify();
+  double k0 = m3->k0.z;
+  EXPECT_DOUBLE_EQ(total, lattice.theta(lattice.circumference()));
+  m3->k0.z = 0.;
+  m3->name = "MX";
+  lattice.modified();
+  EXPECT_DOUBLE_EQ(total - 2.5*k0, lattice.theta(lattice.circumference()));
+  EXPECT_THROW(lattice["M3"], pal::AccLattice::noMatchingElement);
+  EXPECT_EQ(m3, *lattice["MX"]);
+}
+
+TEST_F(AccLatticeTest, replaceElement) {
+  pal::Quadrupole q("QNEW", 0.5, pal::F, 0.1);
+  lattice.mount(8., q);
+  EXPECT_EQ(19u, lattice.size());
+  EXPECT_STREQ("QNEW", lattice[8.2]->name.c_str());
+  EXPECT_THROW(lattice["QD1"], pal::AccLattice::noMatchingElement);
+
+  pal::Quadrupole big("QBIG", 3.0);
+  EXPECT_THROW(lattice.mount(8., big), pal::AccLattice::noFreeSpace);
+  EXPECT_STREQ("QNEW", lattice[8.2]->name.c_str());
+}
+
+TEST_F(AccLatticeTest, copy) {
+  pal::AccLattice copy(lattice);
+  ASSERT_EQ(lattice.size(), copy.size());
+  auto it2 = copy.begin();
+  for (auto it=lattice.begin(); it!=lattice.end(); ++it, ++it2) {
+    EXPECT_EQ(it.pos(), it2.pos());
+    EXPECT_TRUE(*it.element() == *it2.element());
+    EXPECT_EQ(it.element(), it2.element()); // shared until modify()
+  }
+  copy["QF2"].modify()->k1 = 0.1;
+  EXPECT_EQ(0.42, lattice["QF2"].element()->k1);
+  EXPECT_NE(lattice["QF2"].element(), copy["QF2"].element());
+}
+
+TEST_F(AccLatticeTest, copyOnWrite) {
+  const pal::AccLattice &cLattice = lattice;
+  pal::AccLattice *copy = new pal::AccLattice(lattice);
+  const pal::AccLattice &cCopy = *copy;
+  // elements are shared until write access
+  auto it2 = cCopy.begin();
+  for (auto it=cLattice.begin(); it!=cLattice.end(); ++it, ++it2)
+    EXPECT_EQ(it.element(), it2.element());
+
+  // write to copy
+  (*copy)["QF2"].modify()->k1 = 0.1;
+  EXPECT_EQ(0.1, cCopy["QF2"].element()->k1);
+  EXPECT_EQ(0.42, cLattice["QF2"].element()->k1);
+  EXPECT_NE(cLattice["QF2"].element(), cCopy["QF2"].element());
+  EXPECT_EQ(cLattice["QD3"].element(), cCopy["QD3"].element());
+
+  // write to original
+  lattice["QD3"].modify()->k1 = 0.2;
+  EXPECT_EQ(0.42, cCopy["QD3"].element()->k1);
+  EXPECT_EQ(0.2, cLattice["QD3"].element()->k1);
+
+  // theta is recalculated after write access
+  double theta = copy->theta(50.);
+  double k0 = cCopy["M1"].element()->k0.z;
+  (*copy)["M1"].modify()->k0.z = 0.;
+  EXPECT_NEAR(theta - k0*2.5, copy->theta(50.), 1e-12);
+  EXPECT_NEAR(theta, lattice.theta(50.), 1e-12);
+
+  // dismount in copy and delete original
+  copy->dismount(10.);
+  EXPECT_EQ(pal::dipole, lattice[10.5]->type);
+  delete copy;
+  EXPECT_STREQ("M2", lattice[10.5]->name.c_str());
+  EXPECT_EQ(0.42, lattice["QF2"].element()->k1);
+
+  pal::AccLattice copy2(lattice);
+  lattice = pal::AccLattice(60., pal::Anchor::begin);
+  EXPECT_EQ(0u, lattice.size());
+  EXPECT_EQ(0.2, copy2["QD3"].element()->k1);
+  copy2["QD3"].modify()->k1 = 0.3;
+  EXPECT_EQ(0.3, copy2["QD3"].element()->k1);
+}
+
+TEST_F(AccLatticeTest, copyOnWriteReadOnly) {
+  const pal::AccLattice &cLattice = lattice;
+  pal::AccLattice copy(lattice);
+  // non-const iteration, lookup and element() do not copy elements (only modify() does)
+  auto it2 = cLattice.begin();
+  for (auto e : copy) {
+    EXPECT_EQ(it2.element(), e);
+    ++it2;
+  }
+  for (auto it=copy.begin(); it!=copy.end(); ++it) {
+    EXPECT_EQ(cLattice.find(it.pos()).element(), *it);
+    EXPECT_EQ(cLattice.find(it.pos()).element(), it.element());
+  }
+  EXPECT_EQ(cLattice["QF2"].element(), *copy["QF2"]);
+  EXPECT_EQ(cLattice["QF2"].element(), copy["QF2"].element());
+  EXPECT_EQ(cLattice.at(30.).element(), *copy.at(30.));
+}
+
+TEST_F(AccLatticeTest, copyOnWriteExclusive) {
+  const pal::AccLattice &cLattice = lattice;
+  pal::AccLattice *copy = new pal::AccLattice(lattice);
+  pal::AccElement* qf2 = lattice["QF2"].modify(); // copied
+  EXPECT_NE(qf2, (*copy)["QF2"].element());
+  delete copy;
+  // elements are exclusive again after the copy is deleted: no more copies
+  const pal::AccElement* qd3 = cLattice["QD3"].element();
+  EXPECT_EQ(qf2, lattice["QF2"].element());
+  EXPECT_EQ(qd3, lattice["QD3"].element());
+
+  // iterator obtained before copy: writes go to own element
+  auto it = lattice["QF2"];
+  pal::AccLattice copy2(lattice);
+  it.modify()->k1 = 0.5;
+  it.modify()->k1 += 0.1;
+  EXPECT_EQ(0.6, cLattice["QF2"].element()->k1);
+  EXPECT_EQ(0.42, copy2["QF2"].element()->k1);
+}
+
+TEST_F(AccLatticeTest, lazyIndicesThreads) {
+  // reference values, indices are invalid afterwards
+  std::vector<double> pos;
+  for (double p=0.; p<lattice.circumference(); p+=0.7)
+    pos.push_back(p);
+  std::vector<double> theta = lattice.theta(pos);
+  std::vector<const pal::AccElement*> elem;
+  for (double p : pos)
+    elem.push_back(lattice[p]);
+  unsigned int nQuad = lattice.size(pal::quadrupole);
+  double qd3 = lattice["QD3"].pos();
+  lattice.mount(59.9, pal::Marker("END2"));
+
+  // const access from several threads without buildIndices()
+  const pal::AccLattice &cLattice = lattice;
+  std::vector<std::thread> threads;
+  std::vector<unsigned int> errors(4, 0);
+  for (unsigned int i=0; i<4; i++) {
+    threads.emplace_back([&,i]() {
+	for (unsigned int k=0; k<pos.size(); k++) {
+	  if (cLattice[pos[k]] != elem[k] || cLattice.theta(pos[k]) != theta[k])
+	    errors[i]++;
+	}
+	unsigned int n = 0;
+	for (auto it=cLattice.begin<pal::quadrupole>(); it!=cLattice.end(); ++it)
+	  n++;
+	if (n != nQuad || cLattice["QD3"].pos() != qd3 || cLattice["END2"].pos() != 59.9)
+	  errors[i]++;
+      });
+  }
+  for (auto &t : threads)
+    t.join();
+  EXPECT_EQ(std::vector<unsigned int>(4,0), errors);
+}
+
+TEST_F(AccLatticeTest, copyOnWriteThreads) {
+  lattice.buildIndices();
+  const pal::AccElement* qd3 = lattice["QD3"].element();
+  std::vector<std::thread> threads;
+  std::vector<double> k1(4);
+  for (unsigned int i=0; i<4; i++) {
+    threads.emplace_back([this,i,&k1]() {
+	for (unsigned int n=0; n<20; n++) {
+	  pal::AccLattice copy(lattice);
+	  copy["QF2"].modify()->k1 = i;
+	  copy.dismount(10.);
+	  k1[i] = copy["QF2"].element()->k1;
+	}
+      });
+  }
+  for (auto &t : threads)
+    t.join();
+  for (unsigned int i=0; i<4; i++)
+    EXPECT_EQ(double(i), k1[i]);
+  EXPECT_EQ(0.42, lattice["QF2"].element()->k1);
+  EXPECT_EQ(qd3, lattice["QD3"].element());
+  EXPECT_STREQ("M2", lattice[10.5]->name.c_str());
+}
+
+TEST_F(AccLatticeTest, move) {
+  const pal::AccElement* qf2 = lattice["QF2"].element();
+  double theta = lattice.theta(30.);
+  unsigned int n = lattice.size();
+
+  pal::AccLattice moved(std::move(lattice));
+  EXPECT_EQ(n, moved.size());
+  EXPECT_EQ(qf2, moved["QF2"].element());
+  EXPECT_EQ(theta, moved.theta(30.));
+  EXPECT_EQ(pal::quadrupole, moved[8.2]->type);
+  EXPECT_EQ(0u, lattice.size());
+  EXPECT_EQ(pal::drift, lattice[8.2]->type);
+
+  pal::AccLattice assigned(10., pal::Anchor::begin);
+  assigned.mount(1., pal::Quadrupole("QX", 0.5));
+  assigned = std::move(moved);
+  EXPECT_EQ(n, assigned.size());
+  EXPECT_EQ(qf2, assigned["QF2"].element());
+  EXPECT_THROW(assigned["QX"], pal::AccLattice::noMatchingElement);
+  EXPECT_EQ(0u, moved.size());
+
+  // moved-from lattice can be used again
+  lattice.mount(1., pal::Quadrupole("QX", 0.5));
+  EXPECT_EQ(1u, lattice.size());
+  EXPECT_STREQ("QX", lattice[1.2]->name.c_str());
+}
+
+TEST_F(AccLatticeTest, mountBatch) {
+  pal::AccLattice seq(lattice);
+  pal::Quadrupole q1("QB1", 0.5), q2("QB2", 0.3), q3("QB3", 0.4);
+  pal::Marker m("MK");
+  std::vector<std::pair<double,const pal::AccElement*>> batch = {{56.,&q2}, {1.,&q1}, {8.,&q3}, {55.5,&m}, {1.,&q2}};
+  for (auto &b : batch)
+    seq.mount(b.first, *b.second);
+  lattice.mountBatch(batch);
+
+  ASSERT_EQ(seq.size(), lattice.size());
+  auto it2 = seq.begin();
+  for (auto it=lattice.begin(); it!=lattice.end(); ++it, ++it2) {
+    EXPECT_EQ(it2.pos(), it.pos());
+    EXPECT_EQ(it2.element()->name, it.element()->name);
+  }
+  EXPECT_EQ(seq.circumference(), lattice.circumference());
+  EXPECT_STREQ("QB2", lattice[1.1]->name.c_str());
+
+  // nothing mounted if one element does not fit
+  pal::Dipole d("DB", 2.);
+  batch = {{0.,&q1}, {6.,&d}};
+  EXPECT_THROW(lattice.mountBatch(batch), pal::AccLattice::noFreeSpace);
+  batch = {{0.,&q1}, {0.2,&q2}};
+  EXPECT_THROW(lattice.mountBatch(batch), pal::AccLattice::noFreeSpace);
+  EXPECT_EQ(seq.size(), lattice.size());
+  EXPECT_EQ(pal::drift, lattice[0.1]->type);
+}
+
+TEST(AccLatticeImport, madximport) {
+  pal::SimToolInstance madx(pal::madx, pal::offline, TEST_MADX_TWISS_FILE);
+  pal::AccLattice lattice(madx, pal::Anchor::begin);
+  EXPECT_EQ(12., lattice.circumference());
+  EXPECT_EQ(7u, lattice.size()); // no drift
+  EXPECT_EQ(2u, lattice.size(pal::dipole));
+  const pal::AccLattice &cLattice = lattice;
+  EXPECT_EQ(1., cLattice["QF1"].pos());
+  EXPECT_DOUBLE_EQ(0.5, cLattice["QF1"].element()->k1);
+  EXPECT_DOUBLE_EQ(-0.5, cLattice["QD1"].element()->k1);
+  EXPECT_EQ(2., cLattice["MB1"].pos());
+  EXPECT_DOUBLE_EQ(0.05, cLattice["MB1"].element()->k0.z);
+  EXPECT_EQ(0.05, cLattice["MB1"].element()->e1);
+  EXPECT_EQ(0.015, cLattice["MB1"].element()->halfWidth.z);
+  EXPECT_DOUBLE_EQ(-0.001, cLattice["MB1"].element()->tilt); // dipealign
+  EXPECT_EQ(0., cLattice["MB2"].element()->tilt);
+  EXPECT_DOUBLE_EQ(0.5e6, cLattice["CAV"].element()->volt);
+  EXPECT_DOUBLE_EQ(500e6, cLattice["CAV"].element()->freq);
+
+  // import fails (no free space): lattice unchanged
+  pal::AccLattice other(12., pal::Anchor::begin);
+  other.mount(8., pal::Quadrupole("QX", 0.5)); // overlaps MB2
+  EXPECT_THROW(other.madximport(madx), pal::AccLattice::noFreeSpace);
+  EXPECT_EQ(1u, other.size());
+  EXPECT_STREQ("QX", other[8.]->name.c_str());
+}
+
+TEST_F(AccLatticeTest, madximportMisalignments) {
+  pal::Quadrupole q("QDUP", 0.5);
+  lattice.mount(1., q);
+  lattice.mount(53., q);
+  pal::AccLattice copy(lattice);
+  lattice.madximportMisalignments(pal::quadrupole, TEST_EALIGN_FILE);
+
+  // all rows with matching name added to each element with this name (tilt = -DPSI)
+  for (double pos : {1., 53.}) {
+    const pal::AccElement* e = lattice[pos+0.1];
+    EXPECT_NEAR(-0.004, e->tilt, 1e-12) << "at " << pos << " m";
+    EXPECT_NEAR(0.0003, e->displacement.x, 1e-12) << "at " << pos << " m";
+    EXPECT_NEAR(-0.0001, e->displacement.z, 1e-12) << "at " << pos << " m";
+  }
+  const pal::AccLattice &cLattice = lattice;
+  const pal::AccElement* qf2 = cLattice["QF2"].element();
+  EXPECT_NEAR(0.002, qf2->tilt, 1e-12);
+  EXPECT_NEAR(0.0003, qf2->displacement.x, 1e-12);
+  EXPECT_EQ(0., qf2->displacement.z);
+
+  // other elements and other types (sextupole QDX) unchanged, copy unchanged
+  unsigned int changed = 0;
+  for (auto it=cLattice.begin(); it!=cLattice.end(); ++it) {
+    if ((*it)->tilt != 0. || (*it)->displacement != pal::AccPair())
+      changed++;
+  }
+  EXPECT_EQ(3u, changed);
+  EXPECT_EQ(0., cLattice["QDX"].element()->tilt);
+  for (auto it=copy.begin(); it!=copy.end(); ++it)
+    EXPECT_EQ(0., (*it)->tilt);
+}
+
+TEST_F(AccLatticeTest, setFamilyPatterns) {
+  lattice.setFamily(pal::D, std::vector<std::string>{"QF2", "M*1"}, pal::quadrupole);
+  EXPECT_EQ(pal::D, lattice["QF2"].element()->family);
+  EXPECT_EQ(pal::F, lattice["QF6"].element()->family);
+  EXPECT_EQ(pal::F, lattice["M11"].element()->family);
+  lattice.setFamily(pal::D, "M*1");
+  EXPECT_EQ(pal::D, lattice["M11"].element()->family);
+  EXPECT_EQ(pal::D, lattice["M1"].element()->family);
+  EXPECT_EQ(pal::F, lattice["M10"].element()->family);
+}
+
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);